@@ -1,13 +1,21 @@
 import dotenv from "dotenv";
 import {resolve} from "path";
+import ms from "ms";
 
 type Config = {
     SERVER_PORT: number;
     AT_KEY: string;
     RT_KEY: string;
     CAMERA_SERVER_API: string;
+    RESPONSE_DELAY: number;
+    BRIDGE_TOKEN: string;
 };
 
+// untracked secrets like BRIDGE_TOKEN, loaded first so they win over .env
+dotenv.config({
+    path: resolve(".env.local") as string,
+});
+
 const envConfig = dotenv.config({
     path: resolve(".env") as string,
 });
@@ -25,15 +33,29 @@ if (!process.env.AT_SECRET_KEY || !process.env.RT_SECRET_KEY) {
     throw new Error("[app-config]: secret key is required");
 }
 
+if (!process.env.BRIDGE_TOKEN) {
+    throw new Error("[app-config]: bridge token is required");
+}
+
 const config: Config = {
     SERVER_PORT: parseInt(process.env.PORT, 10),
     AT_KEY: `${process.env.AT_SECRET_KEY}`,
     RT_KEY: `${process.env.RT_SECRET_KEY}`,
     CAMERA_SERVER_API: `${process.env.CAMERA_SERVER_API}`,
+    RESPONSE_DELAY: process.env.RESPONSE_DELAY
+        ? ms(process.env.RESPONSE_DELAY)
+        : 0,
+    BRIDGE_TOKEN: `${process.env.BRIDGE_TOKEN}`,
 };
 
 if (config.CAMERA_SERVER_API) {
     console.info("[app-config] CAMERA_SERVER_API=" + config.CAMERA_SERVER_API);
 }
 
+if (config.RESPONSE_DELAY) {
+    console.info(
+        "[app-config] RESPONSE_DELAY=" + config.RESPONSE_DELAY + "ms"
+    );
+}
+
 export default config;
@@ -75,6 +75,33 @@ const vehicleUpdateSchema = zod
     })
     .strict();
 
+const cardCheckBatchSchema = zod
+    .object({
+        checks: zod
+            .array(
+                zod
+                    .object({
+                        cardId: blankCheck(),
+                        gatePos: zod.enum(["R", "L"]),
+                    })
+                    .strict()
+            )
+            .min(1)
+            .max(8),
+    })
+    .strict();
+
+// [seq, boot, uptime, "S", "n,n,n,n,n,n"] or [seq, boot, uptime, "R" | "L", result, cardCode]
+const journalUploadSchema = zod
+    .object({
+        boot: zod.number(),
+        uptime: zod.number(),
+        events: zod.array(
+            zod.array(zod.union([zod.number(), zod.string()])).min(5)
+        ),
+    })
+    .strict();
+
 export type UserSignup = zod.infer<typeof signupSchema>;
 
 export type UserLogin = zod.infer<typeof loginSchema>;
@@ -91,6 +118,10 @@ export type CardUpdate = zod.infer<typeof cardUpdateSchema>;
 
 export type CardInsertion = zod.infer<typeof cardInsertionSchema>;
 
+export type CardCheckBatch = zod.infer<typeof cardCheckBatchSchema>;
+
+export type JournalUpload = zod.infer<typeof journalUploadSchema>;
+
 export type VehicleInsertion = zod.infer<typeof vehicleInsertionSchema>;
 
 export type VehicleUpdate = zod.infer<typeof vehicleUpdateSchema>;
@@ -115,12 +146,24 @@ export default {
     ["parkingSlots"]: {
         ["update"]: parkingSlotsUpdateSchema,
     },
+    ["/journal"]: {
+        [RequestMethod.POST]: journalUploadSchema,
+    },
+    ["journal"]: {
+        ["upload"]: journalUploadSchema,
+    },
     ["/cards"]: {
         [RequestMethod.POST]: cardUpdateSchema,
     },
     ["/cards/:id"]: {
         [RequestMethod.PUT]: cardInsertionSchema,
     },
+    ["/cards/linked-vehicle/batch"]: {
+        [RequestMethod.POST]: cardCheckBatchSchema,
+    },
+    ["card"]: {
+        ["check-batch"]: cardCheckBatchSchema,
+    },
     ["/vehicles"]: {
         [RequestMethod.POST]: vehicleInsertionSchema,
     },
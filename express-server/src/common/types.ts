@@ -1,4 +1,5 @@
 import type {CardScanningType, ParkingSlot, UserRole} from "@prisma/client";
+import type {CardCheckBatch, JournalUpload} from "@/common/schemas";
 
 export interface UserDTO {
     userId: string;
@@ -28,6 +29,19 @@ export interface ScannedLog {
     createdAt: Date;
 }
 
+// answer to an ESP bridge request, status is a HTTP status code
+export interface BridgeResponse {
+    status: number;
+    message?: string;
+    info?: string | CardCheckResult[];
+}
+
+// answer to one card of a batch, info is the username of an accepted card
+export interface CardCheckResult {
+    status: number;
+    info?: string;
+}
+
 export interface ClientEvents {
     "user:join": () => void;
     "user:leave": () => void;
@@ -36,6 +50,23 @@ export interface ClientEvents {
     "cardlist-page:leave": (userId: string) => void;
     "cardlist-page-authorized:join": () => void;
     "cardlist-page-authorized:leave": () => void;
+    "bridge:join": (callback: (response: BridgeResponse) => void) => void;
+    "card:check": (
+        payload: {cardId: string; gatePos: string},
+        callback: (response: BridgeResponse) => void
+    ) => void;
+    "card:check-batch": (
+        payload: CardCheckBatch,
+        callback: (response: BridgeResponse) => void
+    ) => void;
+    "journal:upload": (
+        payload: JournalUpload,
+        callback: (response: BridgeResponse) => void
+    ) => void;
+    "parking-slot:change": (
+        payload: {states?: string; changes?: string},
+        callback: (response: BridgeResponse) => void
+    ) => void;
 }
 
 export interface ServerEvents {
@@ -44,4 +75,5 @@ export interface ServerEvents {
         offSet: number
     ) => void;
     "card:update": (payload: {log: ScannedLog}) => void;
+    "gate:command": (payload: {gatePos: string; action: "open"}) => void;
 }
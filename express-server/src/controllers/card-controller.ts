@@ -1,14 +1,10 @@
 import {ResponseMessage} from "@/common/constants";
-import {CardInsertion, CardUpdate} from "@/common/schemas";
+import {CardCheckBatch, CardInsertion, CardUpdate} from "@/common/schemas";
 import cardService from "@/services/card-service";
 import {Request, Response} from "express";
 import {StatusCodes} from "http-status-codes";
-import axios, {AxiosError} from "axios";
-import config from "@/common/app-config";
-import {CardScanningType} from "@prisma/client";
-import checkinLogService from "@/services/checkin-log-service";
+import gateService from "@/services/gate-service";
 import socketService from "@/services/socket-service";
-import {ScannedLog} from "@/common/types";
 
 const getCards = async (req: Request, res: Response) => {
     const available = Number(req.query.available);
@@ -63,71 +59,10 @@ const validateCard = async (req: Request, res: Response) => {
         gatePos = gatePos.trim();
         console.debug("incoming cardID and Pos: " + cardId + " " + gatePos);
     }
-    const vehicle = await cardService.getCardLinkedToVehicle(cardId);
-    console.debug("Get vehicle from DB: ", vehicle);
-
-    try {
-        const scanResult = await axios.post<{status: "valid" | "invalid"}>(
-            config.CAMERA_SERVER_API + `?timeout=5000`,
-            {
-                plate_number: vehicle.licensePlate,
-                gate_pos: gatePos,
-            },
-            {
-                timeout: 30000,
-            }
-        );
-        console.debug(`python server response: ${scanResult}`);
-
-        //test
-        // const scanResult = {
-        //     data: {
-        //         status: "valid",
-        //     },
-        // };
-
-        if (scanResult.data.status == "valid") {
-            const currentTime: Date = new Date();
-            const cardScanningType =
-                gatePos == `R`
-                    ? CardScanningType.CHECKIN
-                    : CardScanningType.CHECKOUT;
-
-            //update time in card table
-            cardService.updateCardInOutTime(
-                vehicle.cardId,
-                cardScanningType,
-                currentTime
-            );
-
-            const newLog: ScannedLog = {
-                cardId: vehicle.cardId,
-                licensePlate: vehicle.licensePlate,
-                type: cardScanningType,
-                createdAt: currentTime,
-            };
-            //insert new log to checkinLog table
-            checkinLogService.insertLog(newLog);
-            //emit new log to frontend
-            socketService.emitToCardListPageRoom({
-                log: newLog,
-                userId: vehicle.userId,
-            });
-            socketService.emitToCardListAuthorizedPageRoom({
-                log: newLog,
-            });
-        } else {
-            throw new AxiosError();
-        }
-    } catch (error) {
-        if (axios.isAxiosError(error)) {
-            return res.status(StatusCodes.UNPROCESSABLE_ENTITY).json({
-                message: "Failed to validate car license plate",
-            });
-        } else {
-            throw new Error("Unexpected error: " + error);
-        }
-    }
+
+    const {vehicle, log} = await gateService.checkCard(cardId, gatePos);
+    //emit new log to frontend
+    socketService.emitScannedLog({log: log, userId: vehicle.userId});
 
     return res.status(StatusCodes.OK).json({
         message: ResponseMessage.SUCCESS,
@@ -135,10 +70,25 @@ const validateCard = async (req: Request, res: Response) => {
     });
 };
 
+const validateCards = async (req: Request, res: Response) => {
+    const reqBody = req.body as CardCheckBatch;
+
+    const {results, scannedLogs} = await gateService.checkCards(reqBody);
+    scannedLogs.forEach((scannedLog) =>
+        socketService.emitScannedLog(scannedLog)
+    );
+
+    return res.status(StatusCodes.OK).json({
+        message: ResponseMessage.SUCCESS,
+        info: results,
+    });
+};
+
 export default {
     getCards,
     insertCard,
     updateCard,
     deleteCard,
     validateCard,
+    validateCards,
 };
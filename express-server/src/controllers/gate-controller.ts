@@ -0,0 +1,32 @@
+import {Request, Response} from "express";
+import {StatusCodes} from "http-status-codes";
+import {ResponseMessage} from "@/common/constants";
+import socketService from "@/services/socket-service";
+
+/**
+ * Let the next car through a gate without a card, the ESP bridge forwards
+ * the command to the gates
+ */
+const openGate = async (req: Request, res: Response) => {
+    const gatePos = req.params.pos as string;
+
+    if (gatePos !== `R` && gatePos !== `L`) {
+        return res.status(StatusCodes.BAD_REQUEST).json({
+            message: `Gate must be R (entry) or L (exit)`,
+        });
+    }
+
+    if (!socketService.emitGateCommand({gatePos: gatePos, action: "open"})) {
+        return res.status(StatusCodes.SERVICE_UNAVAILABLE).json({
+            message: `Gates are not connected`,
+        });
+    }
+
+    return res.status(StatusCodes.OK).json({
+        message: ResponseMessage.SUCCESS,
+    });
+};
+
+export default {
+    openGate,
+};
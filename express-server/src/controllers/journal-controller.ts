@@ -0,0 +1,23 @@
+import {Request, Response} from "express";
+import {StatusCodes} from "http-status-codes";
+import {ResponseMessage} from "@/common/constants";
+import {JournalUpload} from "@/common/schemas";
+import journalService from "@/services/journal-service";
+import socketService from "@/services/socket-service";
+
+const uploadJournal = async (req: Request, res: Response) => {
+    const upload = req.body as JournalUpload;
+
+    const {parkingStates} = await journalService.replayEvents(upload);
+    if (parkingStates.length > 0) {
+        socketService.emitToParkingRoom({parkingStates: parkingStates});
+    }
+
+    return res.status(StatusCodes.OK).json({
+        message: ResponseMessage.SUCCESS,
+    });
+};
+
+export default {
+    uploadJournal,
+};
@@ -33,8 +33,7 @@ const updateParkingSlots = async (req: Request, res: Response) => {
     }
 
     const newStates = parkingSlotService.convertStringToSLotState(statesString);
-    parkingSlotService.updateSlotsStatus(newStates); //update db
-    const updateSlot = parkingSlotService.getUpdateSlot(newStates);
+    const updateSlot = parkingSlotService.applySlotStates(newStates);
     if (updateSlot.length > 0) {
         console.log(updateSlot);
         socketService.emitToParkingRoom({parkingStates: updateSlot});
@@ -45,8 +44,30 @@ const updateParkingSlots = async (req: Request, res: Response) => {
     });
 };
 
+const patchParkingSlots = async (req: Request, res: Response) => {
+    const changesString = req.body.changes as string;
+
+    if (!parkingSlotService.isValidSlotChangesStringFormat(changesString)) {
+        return res.status(StatusCodes.BAD_REQUEST).json({
+            message: `Changes must be in format id:n,id:n (id from 1 to 6, n can only be 0 or 1)`,
+        });
+    }
+
+    const changedStates =
+        parkingSlotService.convertChangesStringToSlotState(changesString);
+    const updateSlot = parkingSlotService.applySlotStates(changedStates);
+    if (updateSlot.length > 0) {
+        socketService.emitToParkingRoom({parkingStates: updateSlot});
+    }
+
+    return res.status(StatusCodes.OK).json({
+        message: ResponseMessage.SUCCESS,
+    });
+};
+
 export default {
     updateParkingSlots,
+    patchParkingSlots,
     getParkingSlots,
     initParkingSlots,
 };
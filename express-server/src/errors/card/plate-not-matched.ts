@@ -0,0 +1,15 @@
+import {StatusCodes} from "http-status-codes";
+import {ResponsableError} from "../custom-error";
+
+class PlateNotMatchedError extends ResponsableError {
+    StatusCode: number = StatusCodes.UNPROCESSABLE_ENTITY;
+    constructor(public message: string) {
+        super(message);
+        Object.setPrototypeOf(this, PlateNotMatchedError.prototype);
+    }
+    serialize(): {message: string} {
+        return {message: this.message};
+    }
+}
+
+export default PlateNotMatchedError;
@@ -9,6 +9,8 @@ import cookieParser from "cookie-parser";
 import morgan from "morgan";
 import helmet from "helmet";
 import compression from "compression";
+import ms from "ms";
+import config from "@/common/app-config";
 
 class ExpressServer {
     private _app: express.Application;
@@ -21,6 +23,12 @@ class ExpressServer {
     private listen(port: number): void {
         this._app = express();
         this._app.use(morgan("dev"));
+        if (config.RESPONSE_DELAY) {
+            // simulate a slow server when benchmarking the ESP bridge
+            this._app.use((req, res, next) => {
+                setTimeout(next, config.RESPONSE_DELAY);
+            });
+        }
         this._app.use(helmet());
         this._app.use(compression());
         this._app.use(cors(options));
@@ -30,6 +38,9 @@ class ExpressServer {
         this._app.use("*", errorHandler);
 
         this._server = createServer(this._app);
+        // the ESP bridge keeps one connection open between card checks
+        this._server.keepAliveTimeout = ms("10m");
+        this._server.headersTimeout = ms("10m") + ms("1s");
         this._server.listen(port, "0.0.0.0", () => {
             console.info(
                 `[express server]: Express server is running at port ${port}`
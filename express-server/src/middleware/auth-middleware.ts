@@ -6,6 +6,8 @@ import MissingTokenError from "@/errors/auth/missing-token";
 import InvalidTokenError from "@/errors/auth/invalid-token";
 import AccessDenided from "@/errors/auth/access-denied";
 import {UserRole} from "@prisma/client";
+import config from "@/common/app-config";
+import {timingSafeEqual} from "crypto";
 
 const isAuthorized = (req: Request, res: Response, next: NextFunction) => {
     const accessToken: string | string[] | undefined =
@@ -70,9 +72,41 @@ const isAdmin = async (req: Request, res: Response, next: NextFunction) => {
     next();
 };
 
+/**
+ * The ESP bridge passes the shared BRIDGE_TOKEN as a bearer token on HTTP and
+ * in its connection url (?token=...) on socket.io
+ */
+const checkBridgeToken = (token: unknown): boolean => {
+    if (typeof token !== "string") {
+        return false;
+    }
+    const expected = Buffer.from(config.BRIDGE_TOKEN);
+    const given = Buffer.from(token);
+    return (
+        given.length === expected.length && timingSafeEqual(given, expected)
+    );
+};
+
+const isBridge = (req: Request, res: Response, next: NextFunction) => {
+    const accessToken: string | string[] | undefined =
+        req.headers["authorization"];
+
+    if (typeof accessToken !== "string") {
+        throw new MissingTokenError(ResponseMessage.TOKEN_MISSING);
+    }
+
+    if (!checkBridgeToken(accessToken.replace("Bearer ", ""))) {
+        throw new InvalidTokenError(ResponseMessage.TOKEN_INVALID);
+    }
+
+    next();
+};
+
 export const authMiddleware = {
     isAuthorized,
     isAdmin,
     isStaffOrAdmin,
     checkAuth,
+    isBridge,
+    checkBridgeToken,
 };
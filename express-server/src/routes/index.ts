@@ -7,6 +7,8 @@ import videoRoute from "@/routes/v1/video-route";
 import vehicleRoute from "@/routes/v1/vehicle-route";
 import parkingSlotsRoute from "@/routes/v1/parking-slot-route";
 import cardLogsRoute from "@/routes/v1/card-log-route";
+import gateRoute from "@/routes/v1/gate-route";
+import journalRoute from "@/routes/v1/journal-route";
 import {NextFunction} from "express-serve-static-core";
 
 const router = express.Router();
@@ -23,6 +25,8 @@ router.use("/api/v1/videos", space, videoRoute);
 router.use("/api/v1/vehicles", space, vehicleRoute);
 router.use("/api/v1/parking-slots", space, parkingSlotsRoute);
 router.use("/api/v1/scanned-logs", space, cardLogsRoute);
+router.use("/api/v1/gates", space, gateRoute);
+router.use("/api/v1/journal", space, journalRoute);
 router.get("/healthcheck", (req: Request, res: Response) =>
     res.sendStatus(200)
 );
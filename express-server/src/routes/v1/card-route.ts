@@ -26,5 +26,10 @@ router.delete(
     cardController.deleteCard
 );
 router.get("/linked-vehicle", cardController.validateCard);
+router.post(
+    "/linked-vehicle/batch",
+    expressSchemaValidator("/cards/linked-vehicle/batch"),
+    cardController.validateCards
+);
 
 export default router;
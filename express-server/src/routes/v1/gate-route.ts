@@ -0,0 +1,10 @@
+import express from "express";
+import {authMiddleware} from "@/middleware/auth-middleware";
+import gateController from "@/controllers/gate-controller";
+const router = express.Router();
+
+router.use(authMiddleware.isAuthorized, authMiddleware.isStaffOrAdmin);
+
+router.post("/:pos/open", gateController.openGate);
+
+export default router;
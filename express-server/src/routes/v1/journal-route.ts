@@ -0,0 +1,14 @@
+import express from "express";
+import {expressSchemaValidator} from "@/middleware/schema-validator";
+import journalController from "@/controllers/journal-controller";
+import {authMiddleware} from "@/middleware/auth-middleware";
+const router = express.Router();
+
+router.post(
+    "/",
+    authMiddleware.isBridge,
+    expressSchemaValidator("/journal"),
+    journalController.uploadJournal
+);
+
+export default router;
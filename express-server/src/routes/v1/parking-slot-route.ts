@@ -5,5 +5,6 @@ const router = express.Router();
 router.get("/", parkingSlotController.getParkingSlots);
 router.post("/", parkingSlotController.initParkingSlots);
 router.put("/", parkingSlotController.updateParkingSlots);
+router.patch("/", parkingSlotController.patchParkingSlots);
 
 export default router;
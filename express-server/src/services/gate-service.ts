@@ -0,0 +1,122 @@
+import config from "@/common/app-config";
+import {ResponseMessage} from "@/common/constants";
+import {CardCheckBatch} from "@/common/schemas";
+import {CardCheckResult, CardVehicle, ScannedLog} from "@/common/types";
+import {ResponsableError} from "@/errors/custom-error";
+import PlateNotMatchedError from "@/errors/card/plate-not-matched";
+import cardService from "@/services/card-service";
+import checkinLogService from "@/services/checkin-log-service";
+import {CardScanningType} from "@prisma/client";
+import axios from "axios";
+import {StatusCodes} from "http-status-codes";
+
+/**
+ * A card passes when it is linked to a vehicle and the camera at the gate
+ * sees that vehicle's plate. The passing is logged, the caller tells the
+ * frontend
+ */
+const checkCard = async (
+    cardCode: string,
+    gatePos: string
+): Promise<{vehicle: CardVehicle; log: ScannedLog}> => {
+    const vehicle = await cardService.getCardLinkedToVehicle(cardCode);
+    console.debug("Get vehicle from DB: ", vehicle);
+
+    let scanStatus: "valid" | "invalid";
+    try {
+        const scanResult = await axios.post<{status: "valid" | "invalid"}>(
+            config.CAMERA_SERVER_API + `?timeout=5000`,
+            {
+                plate_number: vehicle.licensePlate,
+                gate_pos: gatePos,
+            },
+            {
+                timeout: 30000,
+            }
+        );
+        console.debug(`python server response: ${scanResult}`);
+
+        //test
+        // const scanResult = {
+        //     data: {
+        //         status: "valid",
+        //     },
+        // };
+
+        scanStatus = scanResult.data.status;
+    } catch (error) {
+        if (axios.isAxiosError(error)) {
+            scanStatus = "invalid";
+        } else {
+            throw new Error("Unexpected error: " + error);
+        }
+    }
+
+    if (scanStatus != "valid") {
+        throw new PlateNotMatchedError("Failed to validate car license plate");
+    }
+
+    const currentTime: Date = new Date();
+    const cardScanningType =
+        gatePos == `R` ? CardScanningType.CHECKIN : CardScanningType.CHECKOUT;
+
+    //update time in card table
+    cardService.updateCardInOutTime(
+        vehicle.cardId,
+        cardScanningType,
+        currentTime
+    );
+
+    const log: ScannedLog = {
+        cardId: vehicle.cardId,
+        licensePlate: vehicle.licensePlate,
+        type: cardScanningType,
+        createdAt: currentTime,
+    };
+    //insert new log to checkinLog table
+    checkinLogService.insertLog(log);
+
+    return {vehicle, log};
+};
+
+/**
+ * Check the cards of a batch at the same time. The results keep the order of
+ * the checks and one failed card only fails its own result. Passings are
+ * returned for the caller to tell the frontend
+ */
+const checkCards = async (
+    batch: CardCheckBatch
+): Promise<{
+    results: CardCheckResult[];
+    scannedLogs: {log: ScannedLog; userId: string}[];
+}> => {
+    const settled = await Promise.allSettled(
+        batch.checks.map((check) =>
+            checkCard(check.cardId.trim(), check.gatePos)
+        )
+    );
+
+    const results: CardCheckResult[] = [];
+    const scannedLogs: {log: ScannedLog; userId: string}[] = [];
+    settled.forEach((outcome) => {
+        if (outcome.status === "fulfilled") {
+            const {vehicle, log} = outcome.value;
+            results.push({status: StatusCodes.OK, info: vehicle.username});
+            scannedLogs.push({log: log, userId: vehicle.userId});
+        } else if (outcome.reason instanceof ResponsableError) {
+            results.push({status: outcome.reason.StatusCode});
+        } else {
+            console.debug(
+                `[gate-service] ${ResponseMessage.UNEXPECTED_ERROR}: ${outcome.reason}`
+            );
+            results.push({status: StatusCodes.INTERNAL_SERVER_ERROR});
+        }
+    });
+
+    return {results, scannedLogs};
+};
+
+export default {
+    checkCard,
+    checkCards,
+};
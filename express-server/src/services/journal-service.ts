@@ -0,0 +1,52 @@
+import {JournalUpload} from "@/common/schemas";
+import parkingSlotService from "@/services/parking-slot-service";
+import {ParkingSlot} from "@prisma/client";
+
+/**
+ * Replay what the ESP journaled while the server was unreachable, in order.
+ * Returns the slots that changed. Card events are card checks that failed and
+ * are only logged, a journal never writes a check-in
+ */
+const replayEvents = async (
+    upload: JournalUpload
+): Promise<{parkingStates: ParkingSlot[]}> => {
+    const changedSlots = new Map<number, ParkingSlot>();
+
+    for (const [seq, , , type, value, cardCode] of upload.events) {
+        if (
+            type === `S` &&
+            typeof value === "string" &&
+            parkingSlotService.isValidSlotStateStringFormat(value)
+        ) {
+            const newStates =
+                parkingSlotService.convertStringToSLotState(value);
+            parkingSlotService
+                .getUpdateSlot(newStates)
+                .forEach((slot) => changedSlots.set(slot.slotId, slot));
+            continue;
+        }
+
+        if ((type === `R` || type === `L`) && typeof cardCode === "string") {
+            // only checks the server never answered are journaled, nobody
+            // passed without the plate check so there is nothing to log
+            console.info(
+                `[journal] card ${cardCode} at ${type} not checked, result ${value}, event ${seq}`
+            );
+            continue;
+        }
+
+        console.debug(`[journal] skip unknown event ${seq}`);
+    }
+
+    // only the last state of every slot reaches the db
+    const parkingStates = Array.from(changedSlots.values());
+    if (parkingStates.length > 0) {
+        await parkingSlotService.updateSlotsStatus(parkingStates);
+    }
+
+    return {parkingStates};
+};
+
+export default {
+    replayEvents,
+};
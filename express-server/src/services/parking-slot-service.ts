@@ -56,6 +56,17 @@ const convertStringToSLotState = (input: string): ParkingSlot[] => {
     });
 };
 
+// "2:1,5:0" only lists the slots that changed, slot id then state
+const convertChangesStringToSlotState = (input: string): ParkingSlot[] => {
+    return input.split(",").map((e) => {
+        const [slotId, state] = e.split(":");
+        return {
+            state: state == `1` ? SlotState.UNAVAILABLE : SlotState.AVAILABLE,
+            slotId: parseInt(slotId, 10),
+        };
+    });
+};
+
 const getUpdateSlot = (parkingSlots: ParkingSlot[]): ParkingSlot[] => {
     const updateSlot: ParkingSlot[] = [];
 
@@ -68,11 +79,24 @@ const getUpdateSlot = (parkingSlots: ParkingSlot[]): ParkingSlot[] => {
     return updateSlot;
 };
 
+/**
+ * Store the new states and return the slots that changed since the last update
+ */
+const applySlotStates = (newStates: ParkingSlot[]): ParkingSlot[] => {
+    updateSlotsStatus(newStates); //update db
+    return getUpdateSlot(newStates);
+};
+
 const isValidSlotStateStringFormat = (input: string) => {
     const regex = /^(0|1)(,(0|1)){5}$/;
     return regex.test(input);
 };
 
+const isValidSlotChangesStringFormat = (input: string) => {
+    const regex = /^[1-6]:(0|1)(,[1-6]:(0|1)){0,5}$/;
+    return regex.test(input);
+};
+
 const getIds = (data: {slotId: number}[]) => {
     return data.map((item) => item.slotId);
 };
@@ -89,5 +113,8 @@ export default {
     createSlots,
     convertStringToSLotState,
     isValidSlotStateStringFormat,
+    convertChangesStringToSlotState,
+    isValidSlotChangesStringFormat,
     getUpdateSlot,
+    applySlotStates,
 };
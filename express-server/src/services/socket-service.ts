@@ -1,11 +1,44 @@
-import {ScannedLog, ClientEvents, ServerEvents} from "@/common/types";
+import {
+    ScannedLog,
+    ClientEvents,
+    ServerEvents,
+    BridgeResponse,
+} from "@/common/types";
+import {ResponseMessage} from "@/common/constants";
+import {ResponsableError} from "@/errors/custom-error";
+import gateService from "@/services/gate-service";
+import journalService from "@/services/journal-service";
+import {socketIOSchemaValidator} from "@/middleware/schema-validator";
+import {authMiddleware} from "@/middleware/auth-middleware";
+import parkingSlotService from "@/services/parking-slot-service";
 import {ParkingSlot} from "@prisma/client";
-import {Server} from "socket.io";
+import {StatusCodes} from "http-status-codes";
+import {Server, Socket} from "socket.io";
 
 let io: Server<ClientEvents, ServerEvents>;
 let currentParkingStatesId: number = 0;
 let lastParkingStates: ParkingSlot[];
 
+/**
+ * Card checks, slot states and journals are only taken from the ESP bridge,
+ * a socket is in the bridge room once bridge:join accepted its token
+ */
+const isBridgeSocket = (socket: Socket, callback: unknown): boolean => {
+    if (socket.rooms.has(`bridge`)) {
+        return true;
+    }
+
+    console.warn(
+        `[socket server] refuse bridge event from outside the bridge room : { socketID : ${socket.id}}`
+    );
+    if (typeof callback === "function")
+        callback({
+            status: StatusCodes.FORBIDDEN,
+            message: ResponseMessage.ACCESS_DENIED,
+        });
+    return false;
+};
+
 // clients to server
 const init = (socketIo: Server) => {
     io = socketIo;
@@ -81,6 +114,141 @@ const init = (socketIo: Server) => {
             console.debug(`[socket server] viewer reconnect`);
         });
 
+        // the ESP bridge keeps this socket open and gets its answers
+        // through the acknowledgement of each request
+        // the bridge only sends requests once this is acknowledged with 200
+        socket.on(`bridge:join`, (callback) => {
+            if (
+                !authMiddleware.checkBridgeToken(socket.handshake.query.token)
+            ) {
+                console.warn(
+                    `[socket server] refuse ESP bridge without a valid token : { socketID : ${socket.id}}`
+                );
+                if (typeof callback === "function")
+                    callback({
+                        status: StatusCodes.UNAUTHORIZED,
+                        message: ResponseMessage.TOKEN_INVALID,
+                    });
+                socket.disconnect(true);
+                return;
+            }
+
+            socket.join(`bridge`);
+            console.debug(
+                `[socket server] join ESP bridge to bridge room : { socketID : ${socket.id}}`
+            );
+            if (typeof callback === "function")
+                callback({status: StatusCodes.OK});
+        });
+
+        socket.on(`card:check`, async (payload, callback) => {
+            if (!isBridgeSocket(socket, callback)) {
+                return;
+            }
+
+            const cardId = `${payload?.cardId}`.trim();
+            const gatePos = `${payload?.gatePos}`.trim();
+            console.debug("incoming cardID and Pos: " + cardId + " " + gatePos);
+
+            let response: BridgeResponse;
+            try {
+                const {vehicle, log} = await gateService.checkCard(
+                    cardId,
+                    gatePos
+                );
+                emitScannedLog({log: log, userId: vehicle.userId});
+                response = {
+                    status: StatusCodes.OK,
+                    info: vehicle.username,
+                };
+            } catch (error) {
+                response =
+                    error instanceof ResponsableError
+                        ? {status: error.StatusCode, message: error.message}
+                        : {
+                              status: StatusCodes.INTERNAL_SERVER_ERROR,
+                              message: ResponseMessage.UNEXPECTED_ERROR,
+                          };
+            }
+            if (typeof callback === "function") callback(response);
+        });
+
+        socket.on(`card:check-batch`, async (payload, callback) => {
+            if (
+                !isBridgeSocket(socket, callback) ||
+                !socketIOSchemaValidator(`card:check-batch`, payload, callback)
+            ) {
+                return;
+            }
+
+            const {results, scannedLogs} =
+                await gateService.checkCards(payload);
+            scannedLogs.forEach((scannedLog) => emitScannedLog(scannedLog));
+            callback({status: StatusCodes.OK, info: results});
+        });
+
+        socket.on(`parking-slot:change`, (payload, callback) => {
+            if (!isBridgeSocket(socket, callback)) {
+                return;
+            }
+
+            let newStates: ParkingSlot[];
+            if (
+                typeof payload?.states === "string" &&
+                parkingSlotService.isValidSlotStateStringFormat(payload.states)
+            ) {
+                newStates = parkingSlotService.convertStringToSLotState(
+                    payload.states
+                );
+            } else if (
+                typeof payload?.changes === "string" &&
+                parkingSlotService.isValidSlotChangesStringFormat(
+                    payload.changes
+                )
+            ) {
+                newStates = parkingSlotService.convertChangesStringToSlotState(
+                    payload.changes
+                );
+            } else {
+                if (typeof callback === "function")
+                    callback({
+                        status: StatusCodes.BAD_REQUEST,
+                        message: `Payload must have states in format n,n,n,n,n,n or changes in format id:n,id:n`,
+                    });
+                return;
+            }
+
+            const updateSlot = parkingSlotService.applySlotStates(newStates);
+            if (updateSlot.length > 0) {
+                emitToParkingRoom({parkingStates: updateSlot});
+            }
+            if (typeof callback === "function")
+                callback({status: StatusCodes.OK});
+        });
+
+        socket.on(`journal:upload`, async (payload, callback) => {
+            if (
+                !isBridgeSocket(socket, callback) ||
+                !socketIOSchemaValidator(`journal:upload`, payload, callback)
+            ) {
+                return;
+            }
+
+            try {
+                const {parkingStates} =
+                    await journalService.replayEvents(payload);
+                if (parkingStates.length > 0) {
+                    emitToParkingRoom({parkingStates: parkingStates});
+                }
+                callback({status: StatusCodes.OK});
+            } catch {
+                callback({
+                    status: StatusCodes.INTERNAL_SERVER_ERROR,
+                    message: ResponseMessage.UNEXPECTED_ERROR,
+                });
+            }
+        });
+
         socket.on(`disconnect`, () => {
             console.debug(
                 `[socket-service] An user with socket ID of ${socket.id} disconnected`
@@ -127,9 +295,32 @@ const emitToCardListAuthorizedPageRoom = (data: {log: ScannedLog}) => {
     io.to(`cardlist-page-authorized`).emit("card:update", data);
 };
 
+const emitScannedLog = (data: {log: ScannedLog; userId: string}) => {
+    emitToCardListPageRoom(data);
+    emitToCardListAuthorizedPageRoom({log: data.log});
+};
+
+/**
+ * @returns false when no ESP bridge is connected to carry the command
+ */
+const emitGateCommand = (data: {gatePos: string; action: "open"}): boolean => {
+    if (!io) {
+        console.debug(`[socket-service] emitGateCommand: io unavailable`);
+        return false;
+    }
+
+    if (!io.sockets.adapter.rooms.get(`bridge`)?.size) {
+        return false;
+    }
+    io.to(`bridge`).emit("gate:command", data);
+    return true;
+};
+
 export default {
     init,
     emitToParkingRoom,
     emitToCardListPageRoom,
     emitToCardListAuthorizedPageRoom,
+    emitScannedLog,
+    emitGateCommand,
 };
@@ -6,22 +6,54 @@
 
 #include "Arduino.h"
 
+#ifdef LCD_ASYNC_TWI
+// Transmissions are collected in _tx and queued on SPS_AsyncTWI. Wire must not
+// be referenced in this mode, its TWI_vect would clash with SPS_AsyncTWI's.
+#include <SPS_AsyncTWI.h>
+#define beginIIC()	(_txLength = 0)
+#define printIIC(args)	(_tx[_txLength++] = (args))
+#define endIIC()	AsyncTWI.write(_Addr, _tx, _txLength)
+#define flushIIC()	AsyncTWI.flush()
+#else
+#define beginIIC()	Wire.beginTransmission(_Addr)
 #define printIIC(args)	Wire.write(args)
+#define endIIC()	Wire.endTransmission()
+#define flushIIC()
+#endif
 inline size_t LiquidCrystal_I2C::write(uint8_t value) {
 	send(value, Rs);
 	return 1;
 }
 
+size_t LiquidCrystal_I2C::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (n < size) {
+		uint8_t sends = 0;
+		beginIIC();
+		for (; n < size && sends < LCD_SENDS_PER_TRANSMISSION; n++, sends++) {
+			queueSend(buffer[n], Rs);
+		}
+		endIIC();
+		_bytesSent += 1 + sends * LCD_BYTES_PER_SEND;
+	}
+	return size;
+}
+
 #else
 #include "WProgram.h"
 
+#define beginIIC()	Wire.beginTransmission(_Addr)
 #define printIIC(args)	Wire.send(args)
+#define endIIC()	Wire.endTransmission()
+#define flushIIC()
 inline void LiquidCrystal_I2C::write(uint8_t value) {
 	send(value, Rs);
 }
 
 #endif
+#ifndef LCD_ASYNC_TWI
 #include "Wire.h"
+#endif
 
 
 
@@ -50,6 +82,9 @@ LiquidCrystal_I2C::LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t l
   _cols = lcd_cols;
   _rows = lcd_rows;
   _backlightval = LCD_NOBACKLIGHT;
+  _bytesSent = 0;
+  _busyPolling = false;
+  _lastWaitInUs = 0;
 }
 
 void LiquidCrystal_I2C::init(){
@@ -58,7 +93,11 @@ void LiquidCrystal_I2C::init(){
 
 void LiquidCrystal_I2C::init_priv()
 {
+#ifdef LCD_ASYNC_TWI
+	AsyncTWI.begin(LCD_TWI_CLOCK);
+#else
 	Wire.begin();
+#endif
 	_displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
 	begin(_cols, _rows);  
 }
@@ -81,7 +120,11 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   
 	// Now we pull both RS and R/W low to begin commands
 	expanderWrite(_backlightval);	// reset expanderand turn backlight off (Bit 8 =1)
-	delay(1000);
+	// the 50ms above is the datasheet's power-on wait and applies in both modes. The extra second
+	// is for slow supplies, with busy polling the controller reports ready after function set instead
+	if (!_busyPolling) {
+		delay(1000);
+	}
 
   	//put the LCD into 4 bit mode
 	// this is according to the hitachi HD44780 datasheet
@@ -105,6 +148,10 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 
 	// set # lines, font size, etc.
 	command(LCD_FUNCTIONSET | _displayfunction);  
+	if (_busyPolling) {
+		// the busy flag is only valid from here on, in 4 bit mode after the reset sequence
+		waitReady(4500);
+	}
 	
 	// turn the display on with no cursor or blinking default
 	_displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
@@ -126,12 +173,12 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 /********** high level commands, for the user! */
 void LiquidCrystal_I2C::clear(){
 	command(LCD_CLEARDISPLAY);// clear display, set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	waitReady(2000);  // this command takes a long time!
 }
 
 void LiquidCrystal_I2C::home(){
 	command(LCD_RETURNHOME);  // set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	waitReady(2000);  // this command takes a long time!
 }
 
 void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row){
@@ -236,12 +283,28 @@ inline void LiquidCrystal_I2C::command(uint8_t value) {
 
 /************ low level data pushing commands **********/
 
-// write either command or data
+// write either command or data, both nibbles in one transmission
 void LiquidCrystal_I2C::send(uint8_t value, uint8_t mode) {
+	beginIIC();
+	queueSend(value, mode);
+	endIIC();
+	_bytesSent += 1 + LCD_BYTES_PER_SEND;
+}
+
+// Queue both nibbles into the open transmission. The PCF8574 latches one byte
+// per ACK, so the bus itself times the enable pulse (>450ns) and the >37us the
+// controller needs between sends: at 400kHz three bytes already take ~67us.
+void LiquidCrystal_I2C::queueSend(uint8_t value, uint8_t mode) {
 	uint8_t highnib=value&0xf0;
 	uint8_t lownib=(value<<4)&0xf0;
-       write4bits((highnib)|mode);
-	write4bits((lownib)|mode); 
+	queueNibble((highnib)|mode);
+	queueNibble((lownib)|mode);
+}
+
+void LiquidCrystal_I2C::queueNibble(uint8_t value) {
+	printIIC((int)(value) | _backlightval);
+	printIIC((int)(value | En) | _backlightval);
+	printIIC((int)(value & ~En) | _backlightval);
 }
 
 void LiquidCrystal_I2C::write4bits(uint8_t value) {
@@ -249,10 +312,68 @@ void LiquidCrystal_I2C::write4bits(uint8_t value) {
 	pulseEnable(value);
 }
 
+// Wait until the controller is ready, at most maxWaitInUs (the datasheet worst case).
+// Without busy polling, or with RW not wired (the pins then read back high), this is a plain delay.
+void LiquidCrystal_I2C::waitReady(unsigned int maxWaitInUs) {
+	unsigned long start = micros();
+	if (!_busyPolling) {
+		flushIIC();	// count from the moment the command left the bus
+		delayMicroseconds(maxWaitInUs);
+	} else {
+		while ((readBusyAddress() & 0x80) && (micros() - start < maxWaitInUs)) {
+		}
+	}
+	_lastWaitInUs = micros() - start;
+}
+
+// Read the busy flag (bit 7) and address counter with RS low and RW high
+uint8_t LiquidCrystal_I2C::readBusyAddress() {
+	uint8_t highnib = readNibble(0);
+	uint8_t lownib = readNibble(0);
+
+	expanderWrite(0);	// RW low again, the next send drives the data lines
+	return highnib | (lownib >> 4);
+}
+
+// One enable pulse in read mode. D4..D7 are written high so the PCF8574
+// quasi-bidirectional pins can be pulled low by the controller.
+uint8_t LiquidCrystal_I2C::readNibble(uint8_t mode) {
+	uint8_t value = 0xF0 | Rw | mode;
+	beginIIC();
+	printIIC((int)(value) | _backlightval);
+	printIIC((int)(value | En) | _backlightval);
+	endIIC();
+
+	uint8_t nibble = readExpander() & 0xF0;
+
+	beginIIC();
+	printIIC((int)(value) | _backlightval);	// En low
+	endIIC();
+	_bytesSent += 3 + 2 + 2;
+	return nibble;
+}
+
+uint8_t LiquidCrystal_I2C::readExpander() {
+#ifdef LCD_ASYNC_TWI
+	uint8_t value = 0xFF;
+	AsyncTWI.read(_Addr, &value, 1);	// waits behind the queued writes
+	return value;
+#elif defined(ARDUINO) && ARDUINO >= 100
+	Wire.requestFrom(_Addr, (uint8_t)1);
+	return Wire.read();
+#else
+	Wire.requestFrom(_Addr, (uint8_t)1);
+	return Wire.receive();
+#endif
+}
+
+// Used by the init sequence and delays that follow it, so it waits for the bus
 void LiquidCrystal_I2C::expanderWrite(uint8_t _data){                                        
-	Wire.beginTransmission(_Addr);
+	beginIIC();
 	printIIC((int)(_data) | _backlightval);
-	Wire.endTransmission();   
+	endIIC();
+	flushIIC();
+	_bytesSent += 2;
 }
 
 void LiquidCrystal_I2C::pulseEnable(uint8_t _data){
@@ -264,6 +385,18 @@ void LiquidCrystal_I2C::pulseEnable(uint8_t _data){
 } 
 
 
+uint32_t LiquidCrystal_I2C::bytesSent(){
+	return _bytesSent;
+}
+
+void LiquidCrystal_I2C::setBusyPolling(bool enabled){
+	_busyPolling = enabled;
+}
+
+unsigned long LiquidCrystal_I2C::lastWaitTime(){
+	return _lastWaitInUs;
+}
+
 // Alias functions
 
 void LiquidCrystal_I2C::cursor_on(){
@@ -4,7 +4,9 @@
 
 #include <inttypes.h>
 #include "Print.h" 
+#ifndef LCD_ASYNC_TWI
 #include <Wire.h>
+#endif
 
 // commands
 #define LCD_CLEARDISPLAY 0x01
@@ -52,6 +54,26 @@
 #define Rw B00000010  // Read/Write bit
 #define Rs B00000001  // Register select bit
 
+// One nibble goes out as 3 expander bytes: data, data with En high, data with En low
+#define LCD_BYTES_PER_SEND 6
+#ifdef BUFFER_LENGTH
+#define LCD_SENDS_PER_TRANSMISSION (BUFFER_LENGTH / LCD_BYTES_PER_SEND)
+#else
+#define LCD_SENDS_PER_TRANSMISSION 5
+#endif
+
+// Bus clock of the interrupt driven transport (build with -D LCD_ASYNC_TWI)
+#ifndef LCD_TWI_CLOCK
+#define LCD_TWI_CLOCK 400000
+#endif
+
+// Clock the LCD bus runs at, Wire stays at its 100kHz default
+#ifdef LCD_ASYNC_TWI
+#define LCD_BUS_CLOCK LCD_TWI_CLOCK
+#else
+#define LCD_BUS_CLOCK 100000
+#endif
+
 class LiquidCrystal_I2C : public Print {
 public:
   LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows);
@@ -80,11 +102,16 @@ public:
   void setCursor(uint8_t, uint8_t); 
 #if defined(ARDUINO) && ARDUINO >= 100
   virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *buffer, size_t size);	// batched, up to LCD_SENDS_PER_TRANSMISSION characters per I2C transmission
+  using Print::write;
 #else
   virtual void write(uint8_t);
 #endif
   void command(uint8_t);
   void init();
+  uint32_t bytesSent();						// I2C bytes put on the bus so far, address bytes included
+  void setBusyPolling(bool enabled);				// poll the busy flag instead of waiting worst-case delays, needs RW wired to P1. Call before init()
+  unsigned long lastWaitTime();					// microseconds the last clear()/home() waited for the controller
 
 ////compatibility API function aliases
 void blink_on();						// alias for blink()
@@ -113,6 +140,12 @@ private:
   void write4bits(uint8_t);
   void expanderWrite(uint8_t);
   void pulseEnable(uint8_t);
+  void queueSend(uint8_t, uint8_t);
+  void queueNibble(uint8_t);
+  uint8_t readBusyAddress();
+  uint8_t readNibble(uint8_t);
+  uint8_t readExpander();
+  void waitReady(unsigned int maxWaitInUs);
   uint8_t _Addr;
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
@@ -121,6 +154,13 @@ private:
   uint8_t _cols;
   uint8_t _rows;
   uint8_t _backlightval;
+  uint32_t _bytesSent;
+  bool _busyPolling;
+  unsigned long _lastWaitInUs;
+#ifdef LCD_ASYNC_TWI
+  uint8_t _tx[LCD_SENDS_PER_TRANSMISSION * LCD_BYTES_PER_SEND];
+  uint8_t _txLength;
+#endif
 };
 
 #endif
@@ -0,0 +1,78 @@
+//Compatible with the Arduino IDE 1.0
+//Measures characters per second with one transmission per character (write(uint8_t))
+//and with batched transmissions (print/write(buffer, size)) at 100kHz and 400kHz,
+//then how long clear() waits with the fixed delay and with busy flag polling
+#include <Wire.h> 
+#include <LiquidCrystal_I2C.h>
+
+#define ROUNDS 10
+
+LiquidCrystal_I2C lcd(0x27,20,4);  // set the LCD address to 0x27 for a 20 chars and 4 line display
+
+const char line[] = "0123456789ABCDEFGHIJ";
+
+unsigned long charByChar()
+{
+  unsigned long start = micros();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int row = 0; row < 4; row++) {
+      lcd.setCursor(0, row);
+      for (int i = 0; i < 20; i++) {
+        lcd.write(line[i]);
+      }
+    }
+  }
+  return micros() - start;
+}
+
+unsigned long batched()
+{
+  unsigned long start = micros();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int row = 0; row < 4; row++) {
+      lcd.setCursor(0, row);
+      lcd.print(line);
+    }
+  }
+  return micros() - start;
+}
+
+void report(const char *name, unsigned long clock, unsigned long duration)
+{
+  Serial.print(name);
+  Serial.print(" @ ");
+  Serial.print(clock / 1000);
+  Serial.print("kHz: ");
+  Serial.print(ROUNDS * 80 * 1000000.0 / duration);
+  Serial.println(" chars/s");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  lcd.init();
+  lcd.backlight();
+
+  const unsigned long clocks[] = { 100000, 400000 };
+  for (int i = 0; i < 2; i++) {
+    Wire.setClock(clocks[i]);
+    report("char by char", clocks[i], charByChar());
+    report("batched", clocks[i], batched());
+  }
+  Wire.setClock(100000);
+
+  lcd.clear();
+  Serial.print("clear, fixed delay: ");
+  Serial.print(lcd.lastWaitTime());
+  Serial.println(" us");
+
+  lcd.setBusyPolling(true);
+  lcd.clear();
+  Serial.print("clear, busy flag: ");
+  Serial.print(lcd.lastWaitTime());
+  Serial.println(" us");
+}
+
+void loop()
+{
+}
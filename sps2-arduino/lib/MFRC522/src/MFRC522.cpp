@@ -33,6 +33,7 @@ MFRC522::MFRC522(	byte chipSelectPin,		///< Arduino pin connected to MFRC522's S
 				) {
 	_chipSelectPin = chipSelectPin;
 	_resetPowerDownPin = resetPowerDownPin;
+	_timeoutInUs = 25000;
 } // End constructor
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -233,8 +234,7 @@ void MFRC522::PCD_Init() {
 	// TPrescaler_Hi are the four low bits in TModeReg. TPrescaler_Lo is TPrescalerReg.
 	PCD_WriteRegister(TModeReg, 0x80);			// TAuto=1; timer starts automatically at the end of the transmission in all communication modes at all speeds
 	PCD_WriteRegister(TPrescalerReg, 0xA9);		// TPreScaler = TModeReg[3..0]:TPrescalerReg, ie 0x0A9 = 169 => f_timer=40kHz, ie a timer period of 25μs.
-	PCD_WriteRegister(TReloadRegH, 0x03);		// Reload timer with 0x3E8 = 1000, ie 25ms before timeout.
-	PCD_WriteRegister(TReloadRegL, 0xE8);
+	PCD_SetTimeout(_timeoutInUs);				// Reload timer, default 0x3E8 = 1000, ie 25ms before timeout.
 	
 	PCD_WriteRegister(TxASKReg, 0x40);		// Default 0x00. Force a 100 % ASK modulation independent of the ModGsPReg register setting
 	PCD_WriteRegister(ModeReg, 0x3D);		// Default 0x3F. Set the preset value for the CRC coprocessor for the CalcCRC command to 0x6363 (ISO 14443-3 part 6.2.4)
@@ -294,6 +294,49 @@ void MFRC522::PCD_AntennaOff() {
 	PCD_ClearRegisterBitMask(TxControlReg, 0x03);
 } // End PCD_AntennaOff()
 
+/**
+ * Set how long the MFRC522 waits for a PICC to answer before TimerIRq fires.
+ * The timer runs at 40kHz (see PCD_Init()), so the value is rounded up to a multiple of 25μs.
+ * A REQA into an empty field always waits the full timeout, so short values speed up polling
+ * while longer values are needed for commands that make the PICC do real work (authenticated reads, writes).
+ */
+void MFRC522::PCD_SetTimeout(	uint16_t timeoutInUs	///< Timeout in microseconds, 25μs..65535μs.
+							) {
+	// in 32 bits, int is 16 bits on AVR. At most 65535 / 25 ticks so _timeoutInUs still fits
+	uint16_t reload = min((timeoutInUs + 24UL) / 25, 65535UL / 25);
+	if (reload == 0) {
+		reload = 1;
+	}
+	_timeoutInUs = reload * 25;
+	PCD_WriteRegister(TReloadRegH, reload >> 8);
+	PCD_WriteRegister(TReloadRegL, reload & 0xFF);
+} // End PCD_SetTimeout()
+
+/**
+ * Get the PICC command timeout currently programmed with PCD_SetTimeout().
+ * 
+ * @return Timeout in microseconds.
+ */
+uint16_t MFRC522::PCD_GetTimeout() {
+	return _timeoutInUs;
+} // End PCD_GetTimeout()
+
+/**
+ * Get how long the PICC took to answer the last command.
+ * With TAuto set the timer starts at the end of the transmission and stops on the first received bits,
+ * so the counter tells the response time. Only meaningful right after a command returned STATUS_OK.
+ * 
+ * @return Response time in microseconds.
+ */
+uint16_t MFRC522::PCD_GetResponseTime() {
+	uint16_t counter = ((uint16_t)PCD_ReadRegister(TCounterValueRegH) << 8) | PCD_ReadRegister(TCounterValueRegL);
+	uint16_t reload = _timeoutInUs / 25;
+	if (counter > reload) {
+		return 0;
+	}
+	return (reload - counter) * 25;
+} // End PCD_GetResponseTime()
+
 /**
  * Get the current MFRC522 Receiver Gain (RxGain[2:0]) value.
  * See 9.3.3.6 / table 98 in http://www.nxp.com/documents/data_sheet/MFRC522.pdf
@@ -495,8 +538,9 @@ MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The co
 	// `waitIRq` parameter define what bits constitute a completed command.
 	// When they are set in the ComIrqReg register, then the command is
 	// considered complete. If the command is not indicated as complete in
-	// ~36ms, then consider the command as timed out.
-	const uint32_t deadline = millis() + 36;
+	// the timer timeout + ~11ms (36ms by default), then consider the command
+	// as timed out.
+	const uint32_t deadline = millis() + _timeoutInUs / 1000 + 11;
 	bool completed = false;
 
 	do {
@@ -505,14 +549,14 @@ MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The co
 			completed = true;
 			break;
 		}
-		if (n & 0x01) {						// Timer interrupt - nothing received in 25ms
+		if (n & 0x01) {						// Timer interrupt - nothing received in _timeoutInUs
 			return STATUS_TIMEOUT;
 		}
 		yield();
 	}
 	while (static_cast<uint32_t> (millis()) < deadline);
 
-	// 36ms and nothing happened. Communication with the MFRC522 might be down.
+	// Deadline passed and nothing happened. Communication with the MFRC522 might be down.
 	if (!completed) {
 		return STATUS_TIMEOUT;
 	}
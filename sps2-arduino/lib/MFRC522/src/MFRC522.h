@@ -296,6 +296,9 @@ public:
 	byte PCD_GetAntennaGain();
 	void PCD_SetAntennaGain(byte mask);
 	bool PCD_PerformSelfTest();
+	void PCD_SetTimeout(uint16_t timeoutInUs);
+	uint16_t PCD_GetTimeout();
+	uint16_t PCD_GetResponseTime();
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Power control functions
@@ -365,6 +368,7 @@ public:
 protected:
 	byte _chipSelectPin;		// Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low)
 	byte _resetPowerDownPin;	// Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low)
+	uint16_t _timeoutInUs;		// Current PICC command timeout programmed into TReloadReg, see PCD_SetTimeout()
 	StatusCode MIFARE_TwoStepHelper(byte command, byte blockAddr, int32_t data);
 };
 
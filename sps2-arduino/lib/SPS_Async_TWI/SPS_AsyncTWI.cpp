@@ -0,0 +1,220 @@
+#include "SPS_AsyncTWI.h"
+
+#if defined(__AVR__) && defined(TWCR)
+
+#include <Arduino.h>
+#include <util/twi.h>
+
+// TWINT cleared, interrupt enabled: let the hardware run the next bus step
+#define TWI_CONTINUE (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+SPS_AsyncTWI AsyncTWI;
+
+ISR(TWI_vect) { AsyncTWI.handleInterrupt(); }
+
+SPS_AsyncTWI::SPS_AsyncTWI()
+    : tail(0), head(0), position(0), queuedCount(0), completedCount(0),
+      errorCount(0), highWaterMark(0), fullWaitCount(0), resetCount(0),
+      owner(NULL) {}
+
+void SPS_AsyncTWI::begin(uint32_t clock) {
+  // internal pull-ups, as Wire does
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+
+  TWSR = 0; // prescaler 1
+  TWBR = ((F_CPU / clock) - 16) / 2;
+  TWCR = _BV(TWEN);
+}
+
+void SPS_AsyncTWI::setOwner(TaskHandle_t task) { owner = task; }
+
+bool SPS_AsyncTWI::write(uint8_t address, const uint8_t *data,
+                         uint8_t length) {
+  if (length > MAX_TRANSFER_LENGTH) {
+    return false;
+  }
+
+  enqueue(address, false, data, length);
+  return true;
+}
+
+bool SPS_AsyncTWI::read(uint8_t address, uint8_t *data, uint8_t length) {
+  if (length > MAX_TRANSFER_LENGTH) {
+    return false;
+  }
+
+  // only the caller queues transfers, so the slot is not reused before it
+  // copies the data out
+  Transfer &transfer = transfers[tail];
+  uint8_t ticket = enqueue(address, true, NULL, length);
+  waitFor(ticket + 1);
+
+  memcpy(data, transfer.data, length);
+  return !transfer.failed;
+}
+
+void SPS_AsyncTWI::flush() { waitFor(queuedCount); }
+
+unsigned int SPS_AsyncTWI::getErrorCount() {
+  taskENTER_CRITICAL();
+  unsigned int count = errorCount;
+  taskEXIT_CRITICAL();
+  return count;
+}
+
+uint8_t SPS_AsyncTWI::getHighWaterMark() { return highWaterMark; }
+
+unsigned int SPS_AsyncTWI::getFullWaitCount() { return fullWaitCount; }
+
+unsigned int SPS_AsyncTWI::getResetCount() { return resetCount; }
+
+uint8_t SPS_AsyncTWI::enqueue(uint8_t address, bool isRead,
+                              const uint8_t *data, uint8_t length) {
+  // wait for a free slot, the bus is the only consumer so this is the
+  // backpressure on the LCD
+  if ((uint8_t)(queuedCount - completedCount) == QUEUE_LENGTH) {
+    fullWaitCount++;
+  }
+  waitFor(queuedCount - QUEUE_LENGTH + 1);
+
+  Transfer &transfer = transfers[tail];
+  transfer.address = address;
+  transfer.isRead = isRead;
+  transfer.failed = false;
+  transfer.length = length;
+  if (!isRead) {
+    memcpy(transfer.data, data, length);
+  }
+
+  taskENTER_CRITICAL();
+  uint8_t ticket = queuedCount;
+  bool idle = queuedCount == completedCount;
+  tail = (tail + 1) % QUEUE_LENGTH;
+  queuedCount++;
+  if ((uint8_t)(queuedCount - completedCount) > highWaterMark) {
+    highWaterMark = queuedCount - completedCount;
+  }
+  if (idle) {
+    TWCR = TWI_CONTINUE | _BV(TWSTA);
+  }
+  taskEXIT_CRITICAL();
+
+  return ticket;
+}
+
+void SPS_AsyncTWI::waitFor(uint8_t ticket) {
+  uint8_t lastCompleted = completedCount;
+  unsigned long progressTime = millis();
+  while ((int8_t)(completedCount - ticket) < 0) {
+    if (owner != NULL) {
+      // every completion notifies, the timeout only covers a non-owner caller
+      ulTaskNotifyTake(pdTRUE, 1);
+    }
+
+    if (completedCount != lastCompleted) {
+      lastCompleted = completedCount;
+      progressTime = millis();
+    } else if (millis() - progressTime >= TIMEOUT_MS) {
+      reset();
+    }
+  }
+}
+
+void SPS_AsyncTWI::handleInterrupt() {
+  Transfer &transfer = transfers[head];
+
+  switch (TW_STATUS) {
+  case TW_START:
+  case TW_REP_START:
+    position = 0;
+    TWDR = (transfer.address << 1) | (transfer.isRead ? TW_READ : TW_WRITE);
+    TWCR = TWI_CONTINUE;
+    break;
+
+  case TW_MT_SLA_ACK:
+  case TW_MT_DATA_ACK:
+    if (position < transfer.length) {
+      TWDR = transfer.data[position++];
+      TWCR = TWI_CONTINUE;
+    } else {
+      complete(false);
+    }
+    break;
+
+  case TW_MR_DATA_ACK:
+    transfer.data[position++] = TWDR;
+    // fall through
+  case TW_MR_SLA_ACK:
+    // ACK every byte but the last one
+    TWCR = position + 1 < transfer.length ? TWI_CONTINUE | _BV(TWEA)
+                                          : TWI_CONTINUE;
+    break;
+
+  case TW_MR_DATA_NACK:
+    transfer.data[position++] = TWDR;
+    complete(false);
+    break;
+
+  case TW_MT_ARB_LOST:
+    // another master won, start again once the bus is free
+    TWCR = TWI_CONTINUE | _BV(TWSTA);
+    break;
+
+  default: // address or data NACK, bus error
+    complete(true);
+    break;
+  }
+}
+
+void SPS_AsyncTWI::complete(bool failed) {
+  transfers[head].failed = failed;
+  if (failed) {
+    errorCount++;
+  }
+
+  head = (head + 1) % QUEUE_LENGTH;
+  completedCount++;
+
+  if (completedCount != queuedCount) {
+    // STOP followed by START of the next queued transfer
+    TWCR = TWI_CONTINUE | _BV(TWSTO) | _BV(TWSTA);
+  } else {
+    TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+  }
+
+  if (owner != NULL) {
+    vTaskNotifyGiveFromISR(owner, NULL);
+  }
+}
+
+// A slave holding SDA low or a STOP that never went out leaves the hardware
+// waiting forever. Fail every queued transfer, clock the slave off the bus and
+// start over
+void SPS_AsyncTWI::reset() {
+  taskENTER_CRITICAL();
+  TWCR = 0;
+  for (uint8_t i = 0; i < (uint8_t)(queuedCount - completedCount); i++) {
+    transfers[(head + i) % QUEUE_LENGTH].failed = true;
+    errorCount++;
+  }
+  head = tail;
+  position = 0;
+  completedCount = queuedCount;
+  resetCount++;
+  taskEXIT_CRITICAL();
+
+  // up to 9 clocks let a slave finish the byte it is sending and release SDA
+  pinMode(SDA, INPUT_PULLUP);
+  for (uint8_t i = 0; i < 9 && digitalRead(SDA) == LOW; i++) {
+    pinMode(SCL, OUTPUT);
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    pinMode(SCL, INPUT_PULLUP);
+    delayMicroseconds(5);
+  }
+
+  TWCR = _BV(TWEN);
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef SPS_AsyncTWI_H
+#define SPS_AsyncTWI_H
+
+#include <Arduino_FreeRTOS.h>
+#include <task.h>
+
+/**
+ * Interrupt driven TWI master for AVR. Transfers are queued and driven by
+ * TWI_vect, so the caller only pays for copying the bytes. Replaces Wire: do
+ * not link both, they define the same interrupt
+ */
+class SPS_AsyncTWI {
+public:
+  static const uint8_t MAX_TRANSFER_LENGTH = 32;
+  static const uint8_t QUEUE_LENGTH = 6;
+  // no transfer completing for this long means the bus is stuck, a full
+  // transfer takes about 3ms at 100kHz
+  static const unsigned long TIMEOUT_MS = 20;
+
+  SPS_AsyncTWI();
+
+  /**
+   * Setup the TWI peripheral as bus master. Must be called before using other
+   * functions
+   * @param   clock   bus clock in Hz, 400000 for fast mode
+   */
+  void begin(uint32_t clock);
+
+  /**
+   * Task notified every time a transfer completes, so it sleeps instead of
+   * spinning while it waits for the bus. Until it is set (e.g. in setup())
+   * waiting busy-loops
+   */
+  void setOwner(TaskHandle_t task);
+
+  /**
+   * Queue a write and return without waiting for the bus. Only waits when
+   * the queue is full
+   * @return false if length is larger than MAX_TRANSFER_LENGTH
+   */
+  bool write(uint8_t address, const uint8_t *data, uint8_t length);
+
+  /**
+   * Queue a read behind the pending writes and wait until it completes
+   * @return false if the device did not answer
+   */
+  bool read(uint8_t address, uint8_t *data, uint8_t length);
+
+  /**
+   * Wait until every queued transfer has left the bus
+   */
+  void flush();
+
+  /**
+   * Number of transfers that were not acknowledged, hit a bus error or were
+   * dropped by a bus reset
+   */
+  unsigned int getErrorCount();
+
+  /**
+   * Most transfers ever queued at once, QUEUE_LENGTH means writers had to wait
+   */
+  uint8_t getHighWaterMark();
+
+  /**
+   * Number of writes that found the queue full and waited for the bus
+   */
+  unsigned int getFullWaitCount();
+
+  /**
+   * Number of times the bus was stuck for TIMEOUT_MS and got reset
+   */
+  unsigned int getResetCount();
+
+  /**
+   * Advance the transfer state machine, called from TWI_vect only
+   */
+  void handleInterrupt();
+
+private:
+  struct Transfer {
+    uint8_t address;
+    bool isRead;
+    bool failed;
+    uint8_t length;
+    uint8_t data[MAX_TRANSFER_LENGTH];
+  };
+
+  Transfer transfers[QUEUE_LENGTH];
+  uint8_t tail;
+  volatile uint8_t head;
+  volatile uint8_t position;
+  // tickets wrap around, only their difference matters
+  uint8_t queuedCount;
+  volatile uint8_t completedCount;
+  volatile unsigned int errorCount;
+  uint8_t highWaterMark;
+  unsigned int fullWaitCount;
+  unsigned int resetCount;
+  TaskHandle_t volatile owner;
+
+  uint8_t enqueue(uint8_t address, bool isRead, const uint8_t *data,
+                  uint8_t length);
+  void waitFor(uint8_t ticket);
+  void complete(bool failed);
+  void reset();
+};
+
+extern SPS_AsyncTWI AsyncTWI;
+
+#endif
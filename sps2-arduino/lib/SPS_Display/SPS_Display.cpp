@@ -1,12 +1,19 @@
 #include "SPS_Display.h"
 #include <Arduino.h>
+#include <SPS_Format.h>
 
-SPS_Display::SPS_Display(uint8_t addr, int fps) : lcd(addr, 20, 4), nextAnimation(0), timeWindow(1000 / fps), lastAnimationTime(-1)
+SPS_Display::SPS_Display(uint8_t addr, int fps) : lcd(addr, COLS, ROWS), nextAnimation(0), lastAnimationTime(-1), timeWindow(windowFor(fps)), lastFrameBytes(0), lastRenderTime(0),
+                                                  lastSlotStates(-1), overlaysChanged(false), i2cBudget(DEFAULT_I2C_BUDGET), budgetWindowStart(0), i2cTimeInWindow(0),
+                                                  i2cTimeLastSecond(0), lastFrameI2CTime(0)
 {
+    memset(frame, ' ', sizeof(frame));
+    memset(shown, ' ', sizeof(shown));
+    memset(overlays, 0, sizeof(overlays));
 }
 
-void SPS_Display::init()
+void SPS_Display::init(bool busyPolling)
 {
+    lcd.setBusyPolling(busyPolling);
     lcd.init();
     lcd.backlight();
 
@@ -16,71 +23,254 @@ void SPS_Display::init()
     lcd.createChar(3, Heart4);
 
     lcd.clear();
+    memset(shown, ' ', sizeof(shown));
 }
 
 void SPS_Display::render(int s1, int s2, int s3, int s4, int s5, int s6)
 {
-    long now = millis();
-    if (lastAnimationTime > -1)
+    unsigned long now = millis();
+    if (now - budgetWindowStart >= 1000)
     {
-        long elapsed = now - lastAnimationTime;
-        long timeToWait = timeWindow - elapsed;
-        if (timeToWait > 0)
-        {
-            return;
-        }
+        i2cTimeLastSecond = i2cTimeInWindow;
+        i2cTimeInWindow = 0;
+        budgetWindowStart = now;
+    }
+
+    // data regions go out as soon as they change, the animation only when it is due and the budget allows it
+    const int slotStates = s1 | (s2 << 1) | (s3 << 2) | (s4 << 3) | (s5 << 4) | (s6 << 5);
+    const bool overlaysExpired = expireOverlays(now);
+    const bool dataChanged = slotStates != lastSlotStates || overlaysExpired || overlaysChanged;
+    const bool animationDue = (lastAnimationTime < 0 || (long)(now - lastAnimationTime) >= timeWindow) && i2cTimeInWindow < i2cBudget;
+    if (!dataChanged && !animationDue)
+    {
+        return;
     }
 
+    unsigned long startTime = micros();
+    uint32_t startBytes = lcd.bytesSent();
     const int slotsLeft = 6 - s1 - s2 - s3 - s4 - s5 - s6;
+    lastSlotStates = slotStates;
+    overlaysChanged = false;
 
+    if (animationDue)
+    {
+        nextAnimation = (nextAnimation + 1) % 4;
+        lastAnimationTime = now;
+    }
+
+    // compose the whole frame, flush() only sends what changed
+    memset(frame, ' ', sizeof(frame));
     animate();
-    lastAnimationTime = now;
 
-    lcd.setCursor(4, 0);
-    lcd.print("Have slot: " + String(slotsLeft));
+    char header[13];
+    SPS_Format(header, sizeof(header)).appendString("Have slot: ").appendInt(slotsLeft);
+    drawString(4, 0, header);
+
+    printSlot(0, 1, 1, s1);
+    printSlot(12, 1, 2, s2);
 
-    lcd.setCursor(0, 1);
-    printSlot(1, s1);
-    lcd.setCursor(12, 1);
-    printSlot(2, s2);
+    printSlot(0, 2, 3, s3);
+    printSlot(12, 2, 4, s4);
 
-    lcd.setCursor(0, 2);
-    printSlot(3, s3);
-    lcd.setCursor(12, 2);
-    printSlot(4, s4);
+    printSlot(0, 3, 5, s5);
+    printSlot(12, 3, 6, s6);
 
-    lcd.setCursor(0, 3);
-    printSlot(5, s5);
-    lcd.setCursor(12, 3);
-    printSlot(6, s6);
+    drawOverlays();
+    flush();
+    lastFrameBytes = lcd.bytesSent() - startBytes;
+    lastRenderTime = micros() - startTime;
+
+    // 9 bit times per byte: 8 data bits and the ACK. In ms and kHz, µs and Hz would overflow 32 bits
+    // from about 477 bytes, less than a full redraw
+    lastFrameI2CTime = (uint32_t)lastFrameBytes * 9 * 1000UL / (LCD_BUS_CLOCK / 1000UL);
+    i2cTimeInWindow += lastFrameI2CTime;
 }
 
 void SPS_Display::animate()
 {
-    lcd.setCursor(0, 0);
-    lcd.write(nextAnimation);
-    lcd.setCursor(2, 0);
-    lcd.write(nextAnimation);
-    lcd.setCursor(17, 0);
-    lcd.write(nextAnimation);
-    lcd.setCursor(19, 0);
-    lcd.write(nextAnimation);
-    nextAnimation = (nextAnimation + 1) % 4;
+    drawChar(0, 0, nextAnimation);
+    drawChar(2, 0, nextAnimation);
+    drawChar(17, 0, nextAnimation);
+    drawChar(19, 0, nextAnimation);
 }
 
-void SPS_Display::printSlot(int slot, int state)
+void SPS_Display::printSlot(uint8_t col, uint8_t row, int slot, int state)
 {
-    char *buf = (char *)malloc(9 * sizeof(char));
-    snprintf(buf, 9, "S%d:%s", slot, state == 1 ? "Fill " : "Empty");
+    char buf[9];
+    SPS_Format(buf, sizeof(buf)).appendChar('S').appendInt(slot).appendChar(':').appendString(state == 1 ? "Fill " : "Empty");
 
-    lcd.print(buf);
-    free(buf);
+    drawString(col, row, buf);
 };
-void SPS_Display::printString(String input){
-    lcd.setCursor(2, 1);
-    lcd.print(input);
+void SPS_Display::printString(const char *input){
+    drawString(2, 1, input);
+    flush();
 };
 
 void SPS_Display::clearScreen(){
-    lcd.clear();
-};
\ No newline at end of file
+    memset(frame, ' ', sizeof(frame));
+    flush();
+};
+
+void SPS_Display::showOverlay(uint8_t region, const char *text, uint8_t priority, unsigned long durationInMs)
+{
+    if (region >= TOTAL_REGIONS)
+    {
+        return;
+    }
+
+    Overlay &overlay = overlays[region];
+    unsigned long now = millis();
+    if (overlay.active && now - overlay.startTime < overlay.durationInMs && overlay.priority > priority)
+    {
+        return;
+    }
+
+    strncpy(overlay.text, text, COLS);
+    overlay.text[COLS] = '\0';
+    overlay.priority = priority;
+    overlay.startTime = now;
+    overlay.durationInMs = durationInMs;
+    overlay.active = true;
+    overlaysChanged = true;
+}
+
+void SPS_Display::clearOverlay(uint8_t region)
+{
+    if (region >= TOTAL_REGIONS)
+    {
+        return;
+    }
+
+    overlays[region].active = false;
+    overlaysChanged = true;
+}
+
+bool SPS_Display::expireOverlays(unsigned long now)
+{
+    bool expired = false;
+    for (uint8_t region = 0; region < TOTAL_REGIONS; region++)
+    {
+        Overlay &overlay = overlays[region];
+        if (overlay.active && now - overlay.startTime >= overlay.durationInMs)
+        {
+            overlay.active = false;
+            expired = true;
+        }
+    }
+    return expired;
+}
+
+void SPS_Display::drawOverlays()
+{
+    for (uint8_t region = 0; region < TOTAL_REGIONS; region++)
+    {
+        Overlay &overlay = overlays[region];
+        if (!overlay.active)
+        {
+            continue;
+        }
+
+        uint8_t row = region + 1;
+        memset(frame[row], ' ', COLS);
+        drawString(OVERLAY_COL, row, overlay.text);
+    }
+}
+
+void SPS_Display::drawString(uint8_t col, uint8_t row, const char *text)
+{
+    if (row >= ROWS)
+    {
+        return;
+    }
+
+    for (; col < COLS && *text != '\0'; col++, text++)
+    {
+        frame[row][col] = *text;
+    }
+}
+
+void SPS_Display::drawChar(uint8_t col, uint8_t row, uint8_t c)
+{
+    if (row >= ROWS || col >= COLS)
+    {
+        return;
+    }
+
+    frame[row][col] = c;
+}
+
+void SPS_Display::flush()
+{
+    for (uint8_t row = 0; row < ROWS; row++)
+    {
+        uint8_t col = 0;
+        while (col < COLS)
+        {
+            if (frame[row][col] == shown[row][col])
+            {
+                col++;
+                continue;
+            }
+
+            // Grow the run over changed cells. A single unchanged cell between two changes is
+            // rewritten too, since it costs the same as the setCursor it saves
+            uint8_t end = col + 1;
+            while (end < COLS)
+            {
+                if (frame[row][end] != shown[row][end])
+                {
+                    end++;
+                }
+                else if (end + 1 < COLS && frame[row][end + 1] != shown[row][end + 1])
+                {
+                    end += 2;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            lcd.setCursor(col, row);
+            lcd.write(&frame[row][col], end - col);
+            memcpy(&shown[row][col], &frame[row][col], end - col);
+            col = end;
+        }
+    }
+}
+
+unsigned int SPS_Display::getLastFrameBytes()
+{
+    return lastFrameBytes;
+}
+
+unsigned long SPS_Display::getLastRenderTime()
+{
+    return lastRenderTime;
+}
+
+unsigned long SPS_Display::getLastFrameI2CTime()
+{
+    return lastFrameI2CTime;
+}
+
+unsigned long SPS_Display::getI2CTimeLastSecond()
+{
+    return i2cTimeLastSecond;
+}
+
+void SPS_Display::setAnimationRate(int fps)
+{
+    timeWindow = windowFor(fps);
+}
+
+long SPS_Display::windowFor(int fps)
+{
+    // the heart always animates, at least one frame per second and at least 1 ms per frame
+    return 1000 / constrain(fps, 1, 1000);
+}
+
+void SPS_Display::setI2CBudget(unsigned long budgetInUsPerSecond)
+{
+    i2cBudget = budgetInUsPerSecond;
+}
@@ -6,14 +6,24 @@
 class SPS_Display
 {
 public:
+    // Overlay regions, one per gate. Region r covers LCD row r + 1
+    enum Region
+    {
+        ENTRY_REGION,
+        EXIT_REGION,
+        TOTAL_REGIONS
+    };
+
     /**
      * @param   addr    I2C's address of LCD. Texas Instruments’ PCF8574 chip: 0100A2A1A0. NXP’s PCF8574 chip: 0111A2A1A0
-     * @param   fps     Control the animation rate
+     * @param   fps     Control the animation rate, data changes are drawn regardless. Taken as 1 to 1000
      */
     SPS_Display(uint8_t addr, int fps);
 
     /**
-     * Display content to LCD
+     * Display content to LCD, with the active overlays drawn over the slot view. Never blocks.
+     * Slot and overlay changes are sent right away, the animation advances at most fps times
+     * per second and only while the I2C budget of the current second is not used up
      * @param   s1      slot 1 state, 0 means "Empty", 1 means "Full"
      * @param   s2      slot 2 state, 0 means "Empty", 1 means "Full"
      * @param   s3      slot 3 state, 0 means "Empty", 1 means "Full"
@@ -26,19 +36,110 @@ public:
 
     /**
      * Setup LCD connection. Must be called before using other functions
+     * @param   busyPolling     poll the HD44780 busy flag instead of waiting worst-case delays, needs the RW line wired to the PCF8574
      */
-    void init();
+    void init(bool busyPolling = false);
 
-    void printString(String input);
+    void printString(const char *input);
     void clearScreen();
+
+    /**
+     * Show a message over the slot view of a region until it expires. It replaces the message
+     * already shown there unless that one has a higher priority, and reaches the LCD on the next render
+     * @param   region          ENTRY_REGION or EXIT_REGION
+     * @param   text            message, clipped to the LCD width
+     * @param   priority        higher values win over lower ones
+     * @param   durationInMs    how long the message stays
+     */
+    void showOverlay(uint8_t region, const char *text, uint8_t priority, unsigned long durationInMs);
+
+    /**
+     * Remove the message of a region
+     */
+    void clearOverlay(uint8_t region);
+
+    /**
+     * Draw text into the frame buffer, clipped at the end of the row. Nothing is sent until flush()
+     */
+    void drawString(uint8_t col, uint8_t row, const char *text);
+
+    /**
+     * Draw one character (or custom character 0-7) into the frame buffer
+     */
+    void drawChar(uint8_t col, uint8_t row, uint8_t c);
+
+    /**
+     * Send the cells that differ from what the LCD shows, one setCursor per run of changed cells
+     */
+    void flush();
+
+    /**
+     * I2C bytes sent by the last render
+     */
+    unsigned int getLastFrameBytes();
+
+    /**
+     * Duration of the last render in microseconds
+     */
+    unsigned long getLastRenderTime();
+
+    /**
+     * Bus time of the last render in microseconds, computed from its bytes at LCD_BUS_CLOCK
+     */
+    unsigned long getLastFrameI2CTime();
+
+    /**
+     * Bus time spent during the previous second in microseconds, to check against the budget
+     */
+    unsigned long getI2CTimeLastSecond();
+
+    /**
+     * Cap the animation rate, values are taken as 1 to 1000 fps
+     */
+    void setAnimationRate(int fps);
+
+    /**
+     * Bus time per second the display may use. Once spent, the animation pauses until the next
+     * second; data changes are still sent
+     */
+    void setI2CBudget(unsigned long budgetInUsPerSecond);
 private:
+    static const uint8_t COLS = 20;
+    static const uint8_t ROWS = 4;
+    static const uint8_t OVERLAY_COL = 1;
+    static const unsigned long DEFAULT_I2C_BUDGET = 50000;
+
+    struct Overlay
+    {
+        char text[COLS + 1];
+        uint8_t priority;
+        unsigned long startTime;
+        unsigned long durationInMs;
+        bool active;
+    };
+
     LiquidCrystal_I2C lcd;
     int nextAnimation;
     long lastAnimationTime;
     long timeWindow;
+    uint8_t frame[ROWS][COLS];
+    uint8_t shown[ROWS][COLS];
+    unsigned int lastFrameBytes;
+    unsigned long lastRenderTime;
+    Overlay overlays[TOTAL_REGIONS];
+    int lastSlotStates;
+    bool overlaysChanged;
+    unsigned long i2cBudget;
+    unsigned long budgetWindowStart;
+    unsigned long i2cTimeInWindow;
+    unsigned long i2cTimeLastSecond;
+    unsigned long lastFrameI2CTime;
 
+    static long windowFor(int fps);
     void animate();
-    void printSlot(int slot, int state);
+    bool expireOverlays(unsigned long now);
+    void drawOverlays();
+    void printSlot(uint8_t col, uint8_t row, int slot, int state);
 
     uint8_t Heart1[8] = {
         0b00000,
@@ -0,0 +1,177 @@
+#ifndef SPS_EventBus_H
+#define SPS_EventBus_H
+
+#include <Arduino.h>
+#include <Arduino_FreeRTOS.h>
+#include <task.h>
+
+/**
+ * Delivery counters of one mailbox. All but capacity and highWaterMark count
+ * since the last takeStats()
+ */
+struct SPS_MailboxStats {
+  uint16_t delivered;
+  uint16_t overflows;   // events dropped because the mailbox was full
+  uint16_t coalesced;   // events that replaced a queued one with the same key
+  uint32_t lastLatency; // µs from publish to receive of the last event
+  uint32_t maxLatency;
+  uint8_t capacity;
+  uint8_t highWaterMark; // most events ever queued at once, since boot
+};
+
+/**
+ * What a mailbox does with an event it has no room for
+ */
+enum SPS_OverflowPolicy {
+  DROP_OLDEST, // make room by dropping the oldest event, the latest wins
+  DROP_NEWEST, // keep the queued events, the new one is dropped
+  COALESCE     // replace a queued event with the same key, else DROP_OLDEST
+};
+
+/**
+ * Bounded inbox of one subscriber for one event type. Delivering never
+ * blocks, a full mailbox applies its overflow policy instead
+ */
+template <typename Event, uint8_t CAPACITY> class SPS_Mailbox {
+public:
+  /**
+   * @return  true when b supersedes a, e.g. both are for the same gate
+   */
+  typedef bool (*SameKey)(const Event &a, const Event &b);
+
+  /**
+   * @param   policy    overflow policy
+   * @param   sameKey   key compare, only used by COALESCE
+   */
+  SPS_Mailbox(SPS_OverflowPolicy policy = DROP_OLDEST, SameKey sameKey = NULL)
+      : policy(policy), sameKey(sameKey), head(0), count(0),
+        highWaterMark(0) {
+    memset(&stats, 0, sizeof(stats));
+  }
+
+  /**
+   * Called by SPS_Topic::publish(), not by the subscriber
+   * @param   publishTime   micros() of the publish, for the latency
+   */
+  void deliver(const Event &event, uint32_t publishTime) {
+    taskENTER_CRITICAL();
+    if (policy == COALESCE && sameKey != NULL) {
+      for (uint8_t i = 0; i < count; i++) {
+        Slot &queued = slots[(head + i) % CAPACITY];
+        if (sameKey(queued.event, event)) {
+          // keep the older publish time, the latency covers the whole wait
+          queued.event = event;
+          stats.coalesced++;
+          taskEXIT_CRITICAL();
+          return;
+        }
+      }
+    }
+
+    if (count == CAPACITY) {
+      stats.overflows++;
+      if (policy == DROP_NEWEST) {
+        taskEXIT_CRITICAL();
+        return;
+      }
+      head = (head + 1) % CAPACITY;
+      count--;
+    }
+
+    Slot &slot = slots[(head + count) % CAPACITY];
+    slot.event = event;
+    slot.publishTime = publishTime;
+    count++;
+    if (count > highWaterMark) {
+      highWaterMark = count;
+    }
+    taskEXIT_CRITICAL();
+  }
+
+  /**
+   * Take the oldest event, returns right away
+   * @return  false when the mailbox is empty
+   */
+  bool receive(Event &event) {
+    uint32_t now = micros();
+
+    taskENTER_CRITICAL();
+    if (count == 0) {
+      taskEXIT_CRITICAL();
+      return false;
+    }
+    event = slots[head].event;
+    uint32_t latency = now - slots[head].publishTime;
+    head = (head + 1) % CAPACITY;
+    count--;
+
+    stats.delivered++;
+    stats.lastLatency = latency;
+    if (latency > stats.maxLatency) {
+      stats.maxLatency = latency;
+    }
+    taskEXIT_CRITICAL();
+    return true;
+  }
+
+  /**
+   * @return  counters since the last call, then reset them
+   */
+  SPS_MailboxStats takeStats() {
+    taskENTER_CRITICAL();
+    SPS_MailboxStats taken = stats;
+    memset(&stats, 0, sizeof(stats));
+    taskEXIT_CRITICAL();
+
+    taken.capacity = CAPACITY;
+    taken.highWaterMark = highWaterMark;
+    return taken;
+  }
+
+private:
+  struct Slot {
+    Event event;
+    uint32_t publishTime;
+  };
+
+  const SPS_OverflowPolicy policy;
+  const SameKey sameKey;
+  Slot slots[CAPACITY];
+  uint8_t head;
+  uint8_t count;
+  uint8_t highWaterMark;
+  SPS_MailboxStats stats;
+};
+
+/**
+ * Publishes one event type to a fixed list of mailboxes. The list is a static
+ * array, so subscribers are known at compile time:
+ *
+ *   SPS_Mailbox<Event, 2> inbox;
+ *   SPS_Mailbox<Event, 2> *subscribers[] = {&inbox};
+ *   SPS_Topic<Event, 2> topic(subscribers);
+ *
+ * Publishing copies the event into every mailbox, the producer never waits for
+ * a subscriber
+ */
+template <typename Event, uint8_t CAPACITY> class SPS_Topic {
+public:
+  typedef SPS_Mailbox<Event, CAPACITY> Mailbox;
+
+  template <uint8_t N>
+  SPS_Topic(Mailbox *(&subscribers)[N])
+      : subscribers(subscribers), subscriberCount(N) {}
+
+  void publish(const Event &event) {
+    uint32_t now = micros();
+    for (uint8_t i = 0; i < subscriberCount; i++) {
+      subscribers[i]->deliver(event, now);
+    }
+  }
+
+private:
+  Mailbox *const *subscribers;
+  const uint8_t subscriberCount;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "SPS_Format.h"
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+SPS_Format::SPS_Format(char *buffer, size_t size)
+    : buffer(buffer), size(size), used(0) {
+  if (size > 0) {
+    buffer[0] = '\0';
+  }
+}
+
+SPS_Format &SPS_Format::appendString(const char *text) {
+  while (*text != '\0') {
+    appendChar(*text++);
+  }
+  return *this;
+}
+
+SPS_Format &SPS_Format::appendChar(char c) {
+  if (used + 1 < size) {
+    buffer[used++] = c;
+    buffer[used] = '\0';
+  }
+  return *this;
+}
+
+SPS_Format &SPS_Format::appendUInt(unsigned long value) {
+  char digits[MAX_DIGITS];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+
+  // digits are stored least significant first
+  while (count > 0) {
+    appendChar(digits[--count]);
+  }
+  return *this;
+}
+
+SPS_Format &SPS_Format::appendInt(long value) {
+  if (value < 0) {
+    appendChar('-');
+    return appendUInt(-(unsigned long)value);
+  }
+  return appendUInt(value);
+}
+
+SPS_Format &SPS_Format::appendHex(uint8_t value) {
+  appendChar(HEX_DIGITS[value >> 4]);
+  return appendChar(HEX_DIGITS[value & 0x0F]);
+}
@@ -0,0 +1,39 @@
+#ifndef SPS_Format_H
+#define SPS_Format_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Builds text into a caller owned buffer without touching the heap. The
+ * buffer always stays NUL terminated, text that does not fit is cut off.
+ * Appends chain: SPS_Format(buf, sizeof(buf)).appendString("S").appendInt(1)
+ */
+class SPS_Format {
+public:
+  /**
+   * @param   buffer  destination, cleared to an empty string
+   * @param   size    size of buffer including the NUL terminator
+   */
+  SPS_Format(char *buffer, size_t size);
+
+  SPS_Format &appendString(const char *text);
+  SPS_Format &appendChar(char c);
+  SPS_Format &appendUInt(unsigned long value);
+  SPS_Format &appendInt(long value);
+
+  /**
+   * Two uppercase hex digits, e.g. 0x0A becomes "0A"
+   */
+  SPS_Format &appendHex(uint8_t value);
+
+private:
+  // enough for the 10 digits of a 32 bit number
+  static const uint8_t MAX_DIGITS = 10;
+
+  char *buffer;
+  size_t size;
+  size_t used;
+};
+
+#endif
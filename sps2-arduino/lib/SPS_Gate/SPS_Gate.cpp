@@ -2,59 +2,131 @@
 #include "SPS_Gate.h"
 
 SPS_Gate::SPS_Gate(int servoPin, int delayInMs)
-    : servoPin(servoPin), delayInMs(delayInMs), preMovementTime(-1) {}
+    : SPS_Gate(servoPin, delayInMs, DEFAULT_MAX_DEGREE, DEFAULT_MIN_DEGREE,
+               DEFAULT_SPEED) {}
 
 SPS_Gate::SPS_Gate(int servoPin, int delayInMs, int maxDegree, int minDegree,
                    int speed)
-    : MAX_DEGREE(maxDegree), MIN_DEGREE(minDegree), SPEED(speed) {
-  SPS_Gate(servoPin, delayInMs);
-}
+    : MAX_DEGREE(maxDegree), MIN_DEGREE(minDegree), servoPin(servoPin),
+      backend(SERVO_BACKEND), delayInMs(delayInMs), maxSpeed(speed),
+      acceleration(DEFAULT_ACCELERATION), state(CLOSED_STATE),
+      position(maxDegree), velocity(0), writtenDegree(-1), lastTickTime(0),
+      motionStartTime(0), lastMotionTime(0), motionCallback(NULL) {}
 
-void SPS_Gate::init() {
-  servo.attach(servoPin);
-  servo.write(MAX_DEGREE); // nguoc
-}
+void SPS_Gate::init(Backend backend) {
+  if (backend == HARDWARE_PWM_BACKEND && !hardwareServo.attach(servoPin)) {
+    backend = SERVO_BACKEND;
+  }
+  this->backend = backend;
 
-void SPS_Gate::close() { // do lap nguoc
+  if (backend == SERVO_BACKEND) {
+    servo.attach(servoPin);
+  }
 
-  int position = servo.read();
-  if (position == MAX_DEGREE) {
+  // nguoc: closed is MAX_DEGREE, open is MIN_DEGREE
+  state = CLOSED_STATE;
+  position = MAX_DEGREE;
+  velocity = 0;
+  writeDegree(MAX_DEGREE);
+}
+
+void SPS_Gate::close() {
+  if (state == CLOSED_STATE || state == CLOSING_STATE) {
     return;
   }
+  startMotion(CLOSING_STATE);
+}
 
-  long now = millis();
-  if (preMovementTime > -1) {
-    long elapsed = now - preMovementTime;
-    long timeToWait = delayInMs - elapsed;
-    if (timeToWait > 0) {
-      return;
-    }
+void SPS_Gate::open() {
+  if (state == OPEN_STATE || state == OPENING_STATE) {
+    return;
   }
+  startMotion(OPENING_STATE);
+}
 
-  position = position + SPEED > MAX_DEGREE ? MAX_DEGREE : position + SPEED;
+void SPS_Gate::startMotion(State motion) {
+  unsigned long now = millis();
 
-  servo.write(position);
-  preMovementTime = now;
+  // a reversal keeps its tick and velocity, the profile brakes through zero
+  if (state == OPEN_STATE || state == CLOSED_STATE) {
+    lastTickTime = now;
+  }
+  motionStartTime = now;
+  state = motion;
 }
 
-void SPS_Gate::open() {
+void SPS_Gate::update() {
+  if (state == OPEN_STATE || state == CLOSED_STATE) {
+    return;
+  }
 
-  int position = servo.read();
-  if (position == MIN_DEGREE) {
+  unsigned long now = millis();
+  unsigned long elapsed = now - lastTickTime;
+  if (elapsed == 0 || elapsed < (unsigned long)delayInMs) {
     return;
   }
+  lastTickTime = now;
 
-  long now = millis();
-  if (preMovementTime > -1) {
-    long elapsed = now - preMovementTime;
-    long timeToWait = delayInMs - elapsed;
-    if (timeToWait > 0) {
-      return;
+  float dt = (elapsed > MAX_TICK_MS ? MAX_TICK_MS : elapsed) / 1000.0;
+  float target = state == OPENING_STATE ? MIN_DEGREE : MAX_DEGREE;
+  float distance = fabs(target - position);
+  float direction = target > position ? 1 : -1;
+
+  // trapezoid: accelerate up to maxSpeed, brake once the stopping distance
+  // reaches the target. Speed is negative while a reversal is braking
+  float speed = velocity * direction;
+  float brakingDistance =
+      speed > 0 ? speed * speed / (2 * acceleration) : 0;
+  if (distance > brakingDistance) {
+    speed = min(speed + acceleration * dt, maxSpeed);
+  } else {
+    // keep a minimum step so rounding can not stall short of the target
+    speed = max(speed - acceleration * dt, acceleration * dt);
+  }
+
+  float step = speed * dt;
+  if (step >= distance) {
+    position = target;
+    velocity = 0;
+    writeDegree(target);
+
+    state = state == OPENING_STATE ? OPEN_STATE : CLOSED_STATE;
+    lastMotionTime = now - motionStartTime;
+    if (motionCallback != NULL) {
+      motionCallback(*this, state);
     }
+    return;
   }
 
-  position = position - SPEED < MIN_DEGREE ? MIN_DEGREE : position - SPEED;
+  position += direction * step;
+  velocity = direction * speed;
+  writeDegree(round(position));
+}
+
+void SPS_Gate::setMotionProfile(int speed, int acceleration) {
+  maxSpeed = speed;
+  this->acceleration = acceleration;
+}
+
+void SPS_Gate::setMotionCallback(MotionCallback callback) {
+  motionCallback = callback;
+}
+
+SPS_Gate::State SPS_Gate::getState() { return state; }
+
+int SPS_Gate::getPosition() { return round(position); }
+
+unsigned long SPS_Gate::getLastMotionTime() { return lastMotionTime; }
+
+void SPS_Gate::writeDegree(int degree) {
+  if (degree == writtenDegree) {
+    return;
+  }
+  writtenDegree = degree;
 
-  servo.write(position);
-  preMovementTime = now;
-};
\ No newline at end of file
+  if (backend == SERVO_BACKEND) {
+    servo.write(degree);
+  } else {
+    hardwareServo.write(degree);
+  }
+}
@@ -1,48 +1,119 @@
 #ifndef SPS_Gate_H
 #define SPS_Gate_H
 
+#include <SPS_HardwareServo.h>
 #include <Servo.h>
 
 class SPS_Gate {
 public:
+  // How the servo pulse is generated
+  enum Backend {
+    SERVO_BACKEND,       // Servo library, timer interrupt per pulse, any pin
+    HARDWARE_PWM_BACKEND // timer PWM output, no interrupts, 16 bit timer pins only
+  };
+
+  enum State { CLOSED_STATE, OPENING_STATE, OPEN_STATE, CLOSING_STATE };
+
+  /**
+   * Called from update() when the gate reaches OPEN_STATE or CLOSED_STATE
+   */
+  typedef void (*MotionCallback)(SPS_Gate &gate, State state);
+
   /**
    * @param   servoPin    pin for servo
-   * @param   delayInMs   gate opening/closing speed
+   * @param   delayInMs   motion profile tick, the servo is written at most
+   *                      once per tick
    */
   SPS_Gate(int servoPin, int delayInMs);
 
   /**
    * @param   servoPin    pin for servo
-   * @param   delayInMs   gate opening/closing speed
-   * @param   maxDegree   max degree servo can turn
-   * @param   minDegree   min degree servo can turn
+   * @param   delayInMs   motion profile tick, the servo is written at most
+   *                      once per tick
+   * @param   maxDegree   max degree servo can turn, the closed position
+   * @param   minDegree   min degree servo can turn, the open position
+   * @param   speed       max speed in degree/s
    */
   SPS_Gate(int servoPin, int delayInMs, int maxDegree, int minDegree,
            int speed);
 
   /**
-   * setup pin for servo, must be used before other functions
+   * setup pin for servo and move it to the closed position, must be used
+   * before other functions
+   * @param   backend     HARDWARE_PWM_BACKEND falls back to SERVO_BACKEND when
+   *                      the pin has no 16 bit timer output
    */
-  void init();
+  void init(Backend backend = SERVO_BACKEND);
 
   /**
-   * open the gate from current position to MAX_DEGREE
+   * start moving towards MIN_DEGREE, returns right away. Reverses a closing
+   * gate
    */
   void open();
 
   /**
-   * close the gate from current position to MIN_DEGREE
+   * start moving towards MAX_DEGREE, returns right away. Reverses an opening
+   * gate
    */
   void close();
 
+  /**
+   * advance the motion profile, call it as often as possible. Does nothing
+   * between ticks or when the gate is not moving
+   */
+  void update();
+
+  /**
+   * @param   speed         max speed in degree/s
+   * @param   acceleration  acceleration and deceleration in degree/s^2
+   */
+  void setMotionProfile(int speed, int acceleration);
+
+  void setMotionCallback(MotionCallback callback);
+
+  State getState();
+
+  /**
+   * @return  position in degree, tracked by the gate instead of read back
+   */
+  int getPosition();
+
+  /**
+   * @return  duration of the last completed motion in ms
+   */
+  unsigned long getLastMotionTime();
+
 private:
-  const int MAX_DEGREE = 90;
-  const int MIN_DEGREE = 0;
-  const int SPEED = 90;
+  enum {
+    DEFAULT_MAX_DEGREE = 90,
+    DEFAULT_MIN_DEGREE = 0,
+    DEFAULT_SPEED = 180,
+    DEFAULT_ACCELERATION = 720,
+    // a tick longer than this is a stalled task, not a reason to jump
+    MAX_TICK_MS = 100
+  };
+
+  const int MAX_DEGREE;
+  const int MIN_DEGREE;
   int servoPin;
+  Backend backend;
   Servo servo;
+  SPS_HardwareServo hardwareServo;
   int delayInMs;
-  int preMovementTime;
+  float maxSpeed;
+  float acceleration;
+
+  State state;
+  float position;
+  float velocity; // degree/s, positive towards MAX_DEGREE
+  int writtenDegree;
+  unsigned long lastTickTime;
+  unsigned long motionStartTime;
+  unsigned long lastMotionTime;
+  MotionCallback motionCallback;
+
+  void startMotion(State motion);
+  void writeDegree(int degree);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,83 @@
+#include "SPS_HardwareServo.h"
+#include <Servo.h>
+
+SPS_HardwareServo::SPS_HardwareServo()
+    : degree(90), ocr(NULL) {}
+
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+
+// 16MHz / 8 = 0.5 µs per tick, 40000 ticks = 20 ms
+#define TIMER16_PRESCALER 8
+#define TIMER16_TOP 39999
+
+struct Timer16Channel {
+  uint8_t pin;
+  volatile uint8_t *tccrA;
+  volatile uint8_t *tccrB;
+  volatile uint16_t *icr;
+  volatile uint16_t *ocr;
+  uint8_t com;
+};
+
+static const Timer16Channel TIMER16_CHANNELS[] = {
+    {11, &TCCR1A, &TCCR1B, &ICR1, &OCR1A, _BV(COM1A1)},
+    {12, &TCCR1A, &TCCR1B, &ICR1, &OCR1B, _BV(COM1B1)},
+    {13, &TCCR1A, &TCCR1B, &ICR1, &OCR1C, _BV(COM1C1)},
+    {5, &TCCR3A, &TCCR3B, &ICR3, &OCR3A, _BV(COM3A1)},
+    {2, &TCCR3A, &TCCR3B, &ICR3, &OCR3B, _BV(COM3B1)},
+    {3, &TCCR3A, &TCCR3B, &ICR3, &OCR3C, _BV(COM3C1)},
+    {6, &TCCR4A, &TCCR4B, &ICR4, &OCR4A, _BV(COM4A1)},
+    {7, &TCCR4A, &TCCR4B, &ICR4, &OCR4B, _BV(COM4B1)},
+    {8, &TCCR4A, &TCCR4B, &ICR4, &OCR4C, _BV(COM4C1)},
+    {46, &TCCR5A, &TCCR5B, &ICR5, &OCR5A, _BV(COM5A1)},
+    {45, &TCCR5A, &TCCR5B, &ICR5, &OCR5B, _BV(COM5B1)},
+    {44, &TCCR5A, &TCCR5B, &ICR5, &OCR5C, _BV(COM5C1)},
+};
+
+bool SPS_HardwareServo::attach(int pin) {
+  const uint8_t channels =
+      sizeof(TIMER16_CHANNELS) / sizeof(TIMER16_CHANNELS[0]);
+  for (uint8_t i = 0; i < channels; i++) {
+    const Timer16Channel &channel = TIMER16_CHANNELS[i];
+    if (channel.pin != pin) {
+      continue;
+    }
+
+    // mode 14: fast PWM, TOP = ICR. WGMn1 in A, WGMn3:2 in B
+    *channel.tccrA = (*channel.tccrA & ~_BV(WGM10)) | _BV(WGM11) | channel.com;
+    *channel.tccrB = _BV(WGM13) | _BV(WGM12) | _BV(CS11);
+    *channel.icr = TIMER16_TOP;
+    ocr = channel.ocr;
+    break;
+  }
+
+  if (ocr == NULL) {
+    return false;
+  }
+
+  write(degree);
+  pinMode(pin, OUTPUT);
+  return true;
+}
+
+void SPS_HardwareServo::writeMicroseconds(int us) {
+  if (ocr != NULL) {
+    *ocr = (uint32_t)us * (F_CPU / 1000000UL) / TIMER16_PRESCALER;
+  }
+}
+
+#else
+
+bool SPS_HardwareServo::attach(int pin) { return false; }
+
+void SPS_HardwareServo::writeMicroseconds(int us) {}
+
+#endif
+
+void SPS_HardwareServo::write(int degree) {
+  this->degree = constrain(degree, 0, 180);
+  writeMicroseconds(
+      map(this->degree, 0, 180, MIN_PULSE_WIDTH, MAX_PULSE_WIDTH));
+}
+
+int SPS_HardwareServo::read() { return degree; }
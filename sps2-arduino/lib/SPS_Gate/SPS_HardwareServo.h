@@ -0,0 +1,45 @@
+#ifndef SPS_HardwareServo_H
+#define SPS_HardwareServo_H
+
+#include <Arduino.h>
+
+/**
+ * Servo driven straight from a timer's PWM output: the pulse is generated by
+ * the hardware, so there is no interrupt per pulse and no jitter from other
+ * interrupts. Mirrors the Servo API used by SPS_Gate.
+ *
+ * On the Mega pins of Timer1/3/4/5 (2, 3, 5, 6, 7, 8, 11, 12, 13, 44, 45, 46)
+ * run the timer in fast PWM with ICR as TOP: 50 Hz, 0.5 µs steps, about 4000
+ * positions over the servo range. The 8 bit timers are not supported: Timer2
+ * at a servo frame rate only has 64 µs steps, about 30 positions, and the
+ * gate's motion profile would move in visible steps. Reprograms the whole
+ * timer, analogWrite() on the other pins of that timer stops working
+ */
+class SPS_HardwareServo {
+public:
+  SPS_HardwareServo();
+
+  /**
+   * @param   pin     PWM pin for servo
+   * @return  false when the pin has no usable timer output
+   */
+  bool attach(int pin);
+
+  /**
+   * @param   degree  0 to 180, mapped to MIN_PULSE_WIDTH..MAX_PULSE_WIDTH
+   */
+  void write(int degree);
+
+  /**
+   * @return  last written degree
+   */
+  int read();
+
+private:
+  int degree;
+  volatile uint16_t *ocr;
+
+  void writeMicroseconds(int us);
+};
+
+#endif
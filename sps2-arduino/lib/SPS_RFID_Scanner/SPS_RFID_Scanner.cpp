@@ -1,7 +1,11 @@
 #include "SPS_RFID_Scanner.h"
 
 SPS_RFID_Scanner::SPS_RFID_Scanner(int ssPin, int rstPin)
-    : rfid(ssPin, rstPin), isLastCardValid(false) {}
+    : rfid(ssPin, rstPin), validWindowInMs(3000), invalidWindowInMs(5000),
+      recentCards{}, autoTune(true),
+      profiles{{1000, 500, 5000, 0},
+               {5000, 1000, 25000, 0}},
+      stats{0, 0, 0, 0, 0, 0}, statsStartTime(0) {}
 
 void SPS_RFID_Scanner::init(byte **validUIDs, int totalValidUIDs) {
   SPI.begin();
@@ -9,37 +13,170 @@ void SPS_RFID_Scanner::init(byte **validUIDs, int totalValidUIDs) {
   delay(4);
   this->validUIDs = validUIDs;
   this->totalValidUIDs = totalValidUIDs;
+  statsStartTime = millis();
 }
-bool SPS_RFID_Scanner::validateCard() {
+
+bool SPS_RFID_Scanner::readCardEvent(int &cardIndex) {
+  stats.polls++;
+  applyProfile(REQUEST_PROFILE);
   if (!rfid.PICC_IsNewCardPresent()) {
-    return isLastCardValid;
+    return false;
   }
+  observeResponse(REQUEST_PROFILE);
+  stats.cardsPresent++;
 
+  applyProfile(SELECT_PROFILE);
   if (!rfid.PICC_ReadCardSerial()) {
-    isLastCardValid = false;
+    observeTimeout(SELECT_PROFILE);
+    stats.readsFailed++;
+    return false;
+  }
+  observeResponse(SELECT_PROFILE);
+  stats.readsSucceeded++;
+
+  // halt every card, valid or not, so it stops answering REQA while it stays
+  // in the field
+  rfid.PICC_HaltA();
+
+  unsigned long now = millis();
+  if (isSuppressed(now)) {
+    stats.eventsSuppressed++;
     return false;
   }
 
+  cardIndex = findValidCard();
+  rememberCard(now, cardIndex == -1 ? invalidWindowInMs : validWindowInMs);
+  return true;
+}
+
+void SPS_RFID_Scanner::setSuppressionWindows(unsigned long validWindowInMs,
+                                             unsigned long invalidWindowInMs) {
+  this->validWindowInMs = validWindowInMs;
+  this->invalidWindowInMs = invalidWindowInMs;
+}
+
+void SPS_RFID_Scanner::setTimeout(TimeoutProfile profile,
+                                  uint16_t timeoutInUs) {
+  Profile &p = profiles[profile];
+  p.timeoutInUs = timeoutInUs;
+  if (p.minTimeoutInUs > timeoutInUs) {
+    p.minTimeoutInUs = timeoutInUs;
+  }
+  if (p.maxTimeoutInUs < timeoutInUs) {
+    p.maxTimeoutInUs = timeoutInUs;
+  }
+  p.observedInUs = 0;
+}
+
+uint16_t SPS_RFID_Scanner::getTimeout(TimeoutProfile profile) {
+  return profiles[profile].timeoutInUs;
+}
+
+void SPS_RFID_Scanner::setAutoTune(bool enabled) { autoTune = enabled; }
+
+SPS_RFID_Scanner::Stats SPS_RFID_Scanner::takeStats() {
+  unsigned long now = millis();
+  Stats result = stats;
+  result.elapsedInMs = now - statsStartTime;
+
+  stats = {0, 0, 0, 0, 0, 0};
+  statsStartTime = now;
+  return result;
+}
+
+void SPS_RFID_Scanner::applyProfile(TimeoutProfile profile) {
+  // skip the SPI writes when the chip is already programmed for this profile
+  if (rfid.PCD_GetTimeout() != profiles[profile].timeoutInUs) {
+    rfid.PCD_SetTimeout(profiles[profile].timeoutInUs);
+  }
+}
+
+void SPS_RFID_Scanner::observeResponse(TimeoutProfile profile) {
+  if (!autoTune) {
+    return;
+  }
+
+  Profile &p = profiles[profile];
+  uint16_t responseTime = rfid.PCD_GetResponseTime();
+
+  // decaying peak, so one slow card keeps the timeout up for a while
+  uint16_t decayed = p.observedInUs - p.observedInUs / 8;
+  p.observedInUs = responseTime > decayed ? responseTime : decayed;
+
+  unsigned long timeout = (unsigned long)p.observedInUs * TIMEOUT_MARGIN;
+  if (timeout < p.minTimeoutInUs) {
+    timeout = p.minTimeoutInUs;
+  }
+  if (timeout > p.maxTimeoutInUs) {
+    timeout = p.maxTimeoutInUs;
+  }
+  p.timeoutInUs = timeout;
+}
+
+void SPS_RFID_Scanner::observeTimeout(TimeoutProfile profile) {
+  if (!autoTune) {
+    return;
+  }
+
+  Profile &p = profiles[profile];
+  unsigned long timeout = (unsigned long)p.timeoutInUs * 2;
+  p.timeoutInUs =
+      timeout > p.maxTimeoutInUs ? p.maxTimeoutInUs : (uint16_t)timeout;
+}
+
+int SPS_RFID_Scanner::findValidCard() {
+  if (rfid.uid.size != 4) {
+    return -1;
+  }
+
   for (int i = 0; i < totalValidUIDs; i++) {
-    bool match = true;
-    for (byte j = 0; j < 4; j++) {
-      if (rfid.uid.uidByte[j] != validUIDs[i][j]) {
-        match = false;
-        break;
-      }
+    if (memcmp(rfid.uid.uidByte, validUIDs[i], 4) == 0) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+bool SPS_RFID_Scanner::isSuppressed(unsigned long now) {
+  for (int i = 0; i < TOTAL_RECENT_CARDS; i++) {
+    RecentCard &card = recentCards[i];
+    if (card.uidSize != rfid.uid.size ||
+        memcmp(card.uid, rfid.uid.uidByte, card.uidSize) != 0) {
+      continue;
     }
 
-    if (match) {
-      isLastCardValid = true;
-      scannedCardIndex = i;
-      rfid.PICC_HaltA();
-      hasSend = false;
+    if (now - card.lastSeenTime < card.windowInMs) {
+      // a card held at the reader keeps its window open
+      card.lastSeenTime = now;
       return true;
     }
+    return false;
   }
 
-  isLastCardValid = false;
   return false;
 }
 
-void SPS_RFID_Scanner::clearCache() { isLastCardValid = false; };
\ No newline at end of file
+void SPS_RFID_Scanner::rememberCard(unsigned long now,
+                                    unsigned long windowInMs) {
+  // reuse the entry of this card, otherwise replace the least recently seen
+  int slot = 0;
+  for (int i = 0; i < TOTAL_RECENT_CARDS; i++) {
+    RecentCard &card = recentCards[i];
+    if (card.uidSize == rfid.uid.size &&
+        memcmp(card.uid, rfid.uid.uidByte, card.uidSize) == 0) {
+      slot = i;
+      break;
+    }
+    if (card.uidSize == 0 ||
+        now - card.lastSeenTime > now - recentCards[slot].lastSeenTime) {
+      slot = i;
+    }
+  }
+
+  RecentCard &card = recentCards[slot];
+  card.uidSize = rfid.uid.size;
+  memcpy(card.uid, rfid.uid.uidByte, rfid.uid.size);
+  card.lastSeenTime = now;
+  card.windowInMs = windowInMs;
+}
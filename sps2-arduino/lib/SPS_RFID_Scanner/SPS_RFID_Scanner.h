@@ -6,18 +6,100 @@
 
 class SPS_RFID_Scanner {
 public:
+  enum TimeoutProfile {
+    REQUEST_PROFILE, // REQA/WUPA, answered by the card within ~100us
+    SELECT_PROFILE,  // anticollision and select
+    TOTAL_PROFILES
+  };
+
+  struct Stats {
+    unsigned long polls;
+    unsigned long cardsPresent;
+    unsigned long readsSucceeded;
+    unsigned long readsFailed;
+    unsigned long eventsSuppressed;
+    unsigned long elapsedInMs;
+  };
+
   SPS_RFID_Scanner(int ssPin, int rstPin);
-  bool validateCard();
   void init(byte **validUIDs, int totalValidUIDs);
-  void clearCache();
-  bool hasSend;
-  int scannedCardIndex;
+
+  /**
+   * Poll the reader once. Return true exactly once per card presentation: a
+   * card seen again within its suppression window (held at the reader, or
+   * taken away and shown again quickly) does not produce another event
+   * @param   cardIndex   index of the card in validUIDs, -1 if it is unknown
+   */
+  bool readCardEvent(int &cardIndex);
+
+  /**
+   * Set how long the same card is ignored after it was last seen
+   * @param   validWindowInMs     window for cards found in validUIDs
+   * @param   invalidWindowInMs   window for unknown cards
+   */
+  void setSuppressionWindows(unsigned long validWindowInMs,
+                             unsigned long invalidWindowInMs);
+
+  /**
+   * Set how long the reader waits for the card to answer a command of the
+   * given profile. An empty field always costs the full REQUEST_PROFILE
+   * timeout, so keep that one short
+   * @param   profile       command profile
+   * @param   timeoutInUs   timeout in microseconds, rounded up to 25us
+   */
+  void setTimeout(TimeoutProfile profile, uint16_t timeoutInUs);
+
+  /**
+   * Return the current timeout of the given profile in microseconds
+   */
+  uint16_t getTimeout(TimeoutProfile profile);
+
+  /**
+   * When enabled, every profile follows the observed card response times:
+   * it shrinks towards a few times the slowest recent answer and doubles
+   * after a timeout on a present card
+   */
+  void setAutoTune(bool enabled);
+
+  /**
+   * Return poll statistics collected since the previous call and reset them
+   */
+  Stats takeStats();
 
 private:
+  struct RecentCard {
+    byte uid[10];
+    byte uidSize;
+    unsigned long lastSeenTime;
+    unsigned long windowInMs;
+  };
+  struct Profile {
+    uint16_t timeoutInUs;
+    uint16_t minTimeoutInUs;
+    uint16_t maxTimeoutInUs;
+    uint16_t observedInUs;
+  };
+
+  static const int TOTAL_RECENT_CARDS = 4;
+  static const uint16_t TIMEOUT_MARGIN = 3;
+
   MFRC522 rfid;
   byte **validUIDs;
   int totalValidUIDs;
-  bool isLastCardValid;
+  unsigned long validWindowInMs;
+  unsigned long invalidWindowInMs;
+  RecentCard recentCards[TOTAL_RECENT_CARDS];
+  bool autoTune;
+  Profile profiles[TOTAL_PROFILES];
+  Stats stats;
+  unsigned long statsStartTime;
+
+  void applyProfile(TimeoutProfile profile);
+  void observeResponse(TimeoutProfile profile);
+  void observeTimeout(TimeoutProfile profile);
+  int findValidCard();
+  bool isSuppressed(unsigned long now);
+  void rememberCard(unsigned long now, unsigned long windowInMs);
 };
 
-#endif
\ No newline at end of file
+#endif
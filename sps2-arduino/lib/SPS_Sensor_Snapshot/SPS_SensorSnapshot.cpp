@@ -0,0 +1,59 @@
+#include "SPS_SensorSnapshot.h"
+#include <Arduino.h>
+#include <Arduino_FreeRTOS.h>
+#include <task.h>
+
+// keep the compiler from moving data accesses across the sequence updates
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+SPS_SensorSnapshot::SPS_SensorSnapshot() : sequence(0) {
+  memset(&current, 0, sizeof(current));
+}
+
+bool SPS_SensorSnapshot::publish(int slotStates, int gateStates,
+                                 int lightState) {
+  // the writer is the only one changing current, it may read it unguarded
+  if (current.generation != 0 && current.slotStates == slotStates &&
+      current.gateStates == gateStates && current.lightState == lightState) {
+    return false;
+  }
+
+  unsigned long now = millis();
+
+  // a reader of higher priority spinning on an odd sequence would never let
+  // a preempted writer finish, so the writer is never preempted
+  taskENTER_CRITICAL();
+  sequence++;
+  COMPILER_BARRIER();
+  current.slotStates = slotStates;
+  current.gateStates = gateStates;
+  current.lightState = lightState;
+  current.generation++;
+  current.timestamp = now;
+  COMPILER_BARRIER();
+  sequence++;
+  taskEXIT_CRITICAL();
+  return true;
+}
+
+void SPS_SensorSnapshot::read(Values &values) {
+  uint8_t start;
+  while (true) {
+    // always even here, the writer finishes before anyone else runs
+    start = sequence;
+    COMPILER_BARRIER();
+    memcpy(&values, (const void *)&current, sizeof(values));
+    COMPILER_BARRIER();
+
+    // the writer ran during the copy, take it again
+    if (sequence == start) {
+      return;
+    }
+  }
+}
+
+bool SPS_SensorSnapshot::readChanged(Values &values) {
+  uint32_t seen = values.generation;
+  read(values);
+  return values.generation != seen;
+}
@@ -0,0 +1,52 @@
+#ifndef SPS_SensorSnapshot_H
+#define SPS_SensorSnapshot_H
+
+#include <stdint.h>
+
+/**
+ * Latest sensor values shared between one writer task and many reader tasks
+ * (seqlock). The writer copies a few bytes in a critical section, so no task
+ * ever sees a half written snapshot it would have to wait out, whatever its
+ * priority. Readers never lock, they retry when the writer ran during their
+ * copy
+ */
+class SPS_SensorSnapshot {
+public:
+  struct Values {
+    int slotStates;  // bit 5..0: parking slot 1..6
+    int gateStates;  // bit 5..0: entry front, entry back, entry button, exit
+                     // front, exit back, exit button
+    int lightState;  // HIGH or LOW
+    uint32_t generation; // bumped on every change, 0 before the first publish
+    unsigned long timestamp; // millis() of the sample that changed the values
+  };
+
+  SPS_SensorSnapshot();
+
+  /**
+   * Store a new sample. Only one task may publish. Samples equal to the
+   * current values are dropped, so generation only moves on changes
+   * @return  true when the values changed
+   */
+  bool publish(int slotStates, int gateStates, int lightState);
+
+  /**
+   * Copy a consistent set of values
+   */
+  void read(Values &values);
+
+  /**
+   * Copy the values if they changed since the copy in values was taken
+   * @param   values  last copy of the caller, updated when something changed.
+   *                  Zero it before the first call
+   * @return  true when values was updated
+   */
+  bool readChanged(Values &values);
+
+private:
+  // 8 bit so readers load it in one instruction on AVR
+  volatile uint8_t sequence;
+  Values current;
+};
+
+#endif
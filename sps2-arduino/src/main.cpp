@@ -2,9 +2,14 @@
 #include <SPS_Display.h>
 #include <SPS_Infrared_Sensor.h>
 #include <SPS_RFID_Scanner.h>
+#include <SPS_Format.h>
+#include <SPS_SensorSnapshot.h>
+#include <SPS_EventBus.h>
+#ifdef LCD_ASYNC_TWI
+#include <SPS_AsyncTWI.h>
+#endif
 #include <Arduino_FreeRTOS.h>
 #include <task.h>
-#include <semphr.h>
 #include <queue.h>
 
 #define OPEN 1
@@ -17,8 +22,10 @@
 #define ENTRY_VALID_CARD 1
 #define EXIT_INVALID_CARD 3
 #define EXIT_VALID_CARD 4
-#define CHECKING_CARD 2
-#define REQUEST_FAIL 5
+#define ENTRY_CHECKING_CARD 2
+#define EXIT_CHECKING_CARD 6
+#define ENTRY_REQUEST_FAIL 7
+#define EXIT_REQUEST_FAIL 8
 #define UNDETECTED -1
 
 #define IR_CAR_1 22
@@ -32,29 +39,61 @@
 #define IR_EXIT_FRONT 30
 #define IR_EXIT_BACK 31
 
-#define SERVO_ENTER_PIN 9
+#define SERVO_ENTER_PIN 46 // OC5A, both gates need a 16 bit timer pin for a smooth motion profile
 #define SERVO_EXIT_PIN 8
-#define SERVO_DELAY_MS 0
+#define SERVO_DELAY_MS 20 // motion profile tick, one servo frame
+#define GATE_SPEED 180 // degree/s
+#define GATE_ACCELERATION 720 // degree/s^2, a 90 degree motion takes 0.75s
+// #define GATE_BENCHMARK // print how long every gate motion took
+// #define QUEUE_DIAGNOSTICS // print fill, drops and delivery latency of every mailbox and the TWI queue every second
+// #define SNAPSHOT_BENCHMARK // compare sensor snapshot and single slot queue access times at boot
+#define GATE_SERVO_BACKEND SPS_Gate::HARDWARE_PWM_BACKEND // SPS_Gate::SERVO_BACKEND for the interrupt driven Servo library
 
 #define RFID_ENTER_SS_PIN 53
 #define RFID_ENTER_RST_PIN 5
+#define RFID_VALID_CARD_WINDOW_MS 3000
+#define RFID_INVALID_CARD_WINDOW_MS 5000
+// #define RFID_BENCHMARK // print RFID poll rate and read success rate every second
 
 #define ENTRY_BTN_PIN 11 //Button 2
 #define EXIT_BTN_PIN 10 //Button 1
 
 #define LCD_ADDR 0x27
-#define LCD_FPS 60
+#define LCD_FPS 5 // heart animation rate, slot and message changes are drawn right away
+#define LCD_I2C_BUDGET_US 50000 // bus time per second the display may spend
+#define LCD_BUSY_POLLING true
+
+#define CHECKING_MESSAGE_PRIORITY 0
+#define RESULT_MESSAGE_PRIORITY 1
+#define CHECKING_MESSAGE_MS 10000 // the ESP gives up on the server after 10s
+#define RESULT_MESSAGE_MS 2000
+// #define DISPLAY_BENCHMARK // print I2C bytes and render time of the last frame every second
 
 #define LED_PIN 7
 #define LIGHT_SENSOR_PIN 6
 
+#define ESP_LINE_LENGTH 64 // longest ESP command line, longer lines are split
+#define CARD_MESSAGE_LENGTH 32 // "CARD:R:0X6D-0XE2-0XD7-0X21"
+#define STATE_MESSAGE_LENGTH 24 // "STATE:1,0,1,0,1,0"
+
 #define TOTAL_SLOTS 6
 #define TOTAL_SLOTS_BITS_TO_INT 63
 
 #define configTICK_RATE_HZ 1000
 #define MS_PER_TICK (1000 / configTICK_RATE_HZ)
 
-unsigned char** validUIDs = new unsigned char*[6];
+unsigned char validUIDBytes[6][4] = {
+  { 0x6D, 0xE2, 0xD7, 0x21 },  // Thẻ 1
+  { 0x23, 0x0A, 0x54, 0x11 },  // Thẻ 2
+  { 0xE3, 0x9A, 0x66, 0x10 },  // Thẻ 3
+  { 0x43, 0x34, 0x54, 0x10 },  // Thẻ 4
+  { 0x40, 0x1E, 0x4A, 0x12 },  // Thẻ 5
+  { 0x6A, 0xD5, 0x17, 0xA4 }   // Thẻ 6
+};
+unsigned char* validUIDs[6] = {
+  validUIDBytes[0], validUIDBytes[1], validUIDBytes[2],
+  validUIDBytes[3], validUIDBytes[4], validUIDBytes[5]
+};
 
 SPS_InfraredSensor infraredSensor(IR_CAR_1, IR_CAR_2, IR_CAR_3, IR_CAR_4, IR_CAR_5, IR_CAR_6, IR_ENTRY_FRONT, IR_ENTRY_BACK, IR_EXIT_FRONT, IR_EXIT_BACK);
 SPS_Display display(LCD_ADDR, LCD_FPS);
@@ -62,29 +101,65 @@ SPS_Gate entryGate(SERVO_ENTER_PIN, SERVO_DELAY_MS);
 SPS_Gate exitGate(SERVO_EXIT_PIN, SERVO_DELAY_MS);
 SPS_RFID_Scanner entryScanner(RFID_ENTER_SS_PIN, RFID_ENTER_RST_PIN);
 
-QueueHandle_t slotStatesQueue;
+SPS_SensorSnapshot sensorSnapshot;
+
+// a known card was read, the gate is not decided yet
+struct CardRead {
+  int cardIndex;
+};
 
-QueueHandle_t slotNewStatesQueue;
+// a card is sent to the ESP for checking at a gate
+struct CardCheck {
+  int cardIndex;
+  int gate;
+};
 
-QueueHandle_t usernameQueue;
+// CHECKING-RESULT from the ESP: ENTRY_VALID_CARD, ..., EXIT_REQUEST_FAIL
+struct CardVerdict {
+  int result;
+};
 
-QueueHandle_t scannedCardStateQueue;
+struct SlotChanged {
+  int slotStates;
+};
 
-QueueHandle_t gateSignalQueue;
+// USER from the ESP, sent before the verdict of a valid card
+struct UserName {
+  char name[15];
+};
 
-QueueHandle_t lightStateQueue;
+bool sameGate(const CardCheck &a, const CardCheck &b) {
+  return a.gate == b.gate;
+}
 
-QueueHandle_t scannedCardInfoQueue;
+// one mailbox per subscriber, adding a subscriber means adding it to the topic's list.
+// None of them blocks the producer, the policy decides what a full one drops
 
-QueueHandle_t cardWithSpecificGateQueue;
+// repeats of a card while the decision unit is busy add nothing, keep the first read
+SPS_Mailbox<CardRead, 2> decisionUnitCardReads(DROP_NEWEST);
+SPS_Mailbox<CardRead, 2> *cardReadSubscribers[] = { &decisionUnitCardReads };
+SPS_Topic<CardRead, 2> cardReadTopic(cardReadSubscribers);
 
-SemaphoreHandle_t entryGateCardDetectedConsumedByRFIDScanDecisionUnit;
+// one pending check per gate, a newer card at the same gate replaces it
+SPS_Mailbox<CardCheck, 4> espProducerCardChecks(COALESCE, sameGate);
+SPS_Mailbox<CardCheck, 4> displayCardChecks(COALESCE, sameGate);
+SPS_Mailbox<CardCheck, 4> *cardCheckSubscribers[] = { &espProducerCardChecks, &displayCardChecks };
+SPS_Topic<CardCheck, 4> cardCheckTopic(cardCheckSubscribers);
 
-SemaphoreHandle_t exitGateCardDetectedConsumedByRFIDScanDecisionUnit;
+// verdicts and states: the latest one matters
+SPS_Mailbox<CardVerdict, 2> displayCardVerdicts;
+SPS_Mailbox<CardVerdict, 2> gateControllerCardVerdicts;
+SPS_Mailbox<CardVerdict, 2> decisionUnitCardVerdicts;
+SPS_Mailbox<CardVerdict, 2> *cardVerdictSubscribers[] = { &displayCardVerdicts, &gateControllerCardVerdicts, &decisionUnitCardVerdicts };
+SPS_Topic<CardVerdict, 2> cardVerdictTopic(cardVerdictSubscribers);
 
-SemaphoreHandle_t entryGateCardDetectedConsumedByGateCtrl;
+SPS_Mailbox<SlotChanged, 2> espProducerSlotChanges;
+SPS_Mailbox<SlotChanged, 2> *slotChangedSubscribers[] = { &espProducerSlotChanges };
+SPS_Topic<SlotChanged, 2> slotChangedTopic(slotChangedSubscribers);
 
-SemaphoreHandle_t exitGateCardDetectedConsumedByGateCtrl;
+SPS_Mailbox<UserName, 1> displayUserNames;
+SPS_Mailbox<UserName, 1> *userNameSubscribers[] = { &displayUserNames };
+SPS_Topic<UserName, 1> userNameTopic(userNameSubscribers);
 
 TaskHandle_t displayManagerHandle = NULL;
 
@@ -93,40 +168,49 @@ int getBitAt (int srcNum, int index){
   return (srcNum >> index) & 1;
 }
 
-void truncateNBitsEnd (int &srcNum, int n){
-  srcNum = srcNum >> n;
-}
-
 void appendBit (int &srcNum, int value){
   srcNum = (srcNum << 1) + value;
 }
 
+char *trimString (char *text) {
+  while (isspace(*text)) {
+    text++;
+  }
+
+  char *end = text + strlen(text);
+  while (end > text && isspace(*(end - 1))) {
+    end--;
+  }
+  *end = '\0';
+
+  return text;
+}
+
 void printGateAndCardToSerial (int index, bool gate) {
-  String result = "";
-  String gatePrior = gate == ENTRY_GATE ? "R" : "L";
-  
+  char message[CARD_MESSAGE_LENGTH];
+  SPS_Format result(message, sizeof(message));
+
+  result.appendString("CARD:").appendChar(gate == ENTRY_GATE ? 'R' : 'L').appendChar(':');
   for (int i = 0; i < 4; i++) {
-    result += "0x";
-    if (validUIDs[index][i] < 0x10) { 
-      result += "0";
-    }
-    result += String(validUIDs[index][i], HEX); 
-    result.toUpperCase();
+    result.appendString("0X").appendHex(validUIDs[index][i]);
 
     if (i < 3) {
-      result += "-";
+      result.appendChar('-');
     }
   }
 
-  Serial.println("CARD:"+ gatePrior + ":" + result);
+  Serial.println(message);
 }
 
 void printParkingStatesToSerial (int slotStates) {
-  String message = "STATE:";
+  char message[STATE_MESSAGE_LENGTH];
+  SPS_Format result(message, sizeof(message));
+
+  result.appendString("STATE:");
   for (int i = TOTAL_SLOTS - 1; i >= 0; i--) {
-    message += String(getBitAt(slotStates, i));
+    result.appendInt(getBitAt(slotStates, i));
     if (i > 0) {
-      message += ","; 
+      result.appendChar(',');
     }
   }
   Serial.println(message);
@@ -134,7 +218,7 @@ void printParkingStatesToSerial (int slotStates) {
 
 void updateEntryGateStatus(int &entrySwitchLastState, bool &entryMode, bool &currentEntryGateStatus, 
                             bool isEntryFrontSensorDetected, bool isEntryBackSensorDetected, 
-                            int newEntrySwitchState, bool hasSlot) {
+                            int newEntrySwitchState, bool hasSlot, bool &entryCardAccepted) {
   if(newEntrySwitchState != entrySwitchLastState){ // manual mode
     //update related variables
     entrySwitchLastState = newEntrySwitchState;
@@ -153,26 +237,24 @@ void updateEntryGateStatus(int &entrySwitchLastState, bool &entryMode, bool &cur
   if (currentEntryGateStatus == OPEN) {
     if (!isEntryFrontSensorDetected && !isEntryBackSensorDetected) {
         currentEntryGateStatus = CLOSE;
-        entryScanner.clearCache();
     }
   } else {
     if (hasSlot 
       && isEntryFrontSensorDetected
-      && (xSemaphoreTake(entryGateCardDetectedConsumedByGateCtrl, 0) == pdTRUE)) 
+      && entryCardAccepted) 
     {
+      entryCardAccepted = false;
       currentEntryGateStatus = OPEN;
 
     } else { 
       currentEntryGateStatus = CLOSE;
-      entryScanner.clearCache();
-
     }
   }
 }
 
 void updateExitGateStatus(int &exitSwitchLastState, bool &exitMode, bool &currentExitGateStatus,
                           bool isExitFrontSensorDetected, bool isExitBackSensorDetected,
-                          int newExitSwitchState) { 
+                          int newExitSwitchState, bool &exitCardAccepted) { 
   if(newExitSwitchState != exitSwitchLastState){ // manual mode
     //update related variables
     exitSwitchLastState = newExitSwitchState;
@@ -191,25 +273,24 @@ void updateExitGateStatus(int &exitSwitchLastState, bool &exitMode, bool &curren
   if (currentExitGateStatus == OPEN) {
     if (!isExitFrontSensorDetected && !isExitBackSensorDetected) {
       currentExitGateStatus = CLOSE;
-      entryScanner.clearCache();
     }
   } else {
     if (isExitFrontSensorDetected
-      && (xSemaphoreTake(exitGateCardDetectedConsumedByGateCtrl, 0) == pdTRUE)) 
+      && exitCardAccepted) 
     {
+      exitCardAccepted = false;
       currentExitGateStatus = OPEN;
 
     } else {
       currentExitGateStatus = CLOSE;
-      entryScanner.clearCache();
-
     }
   }
 }
 
 void espCommandDispatcher (void *pvParameters) { 
-  String input, label, value;
-  int separatorIndex, result;
+  char input[ESP_LINE_LENGTH];
+  char *separator, *label, *value;
+  size_t length;
 
   while(1) {
     // Serial.println(1);
@@ -217,58 +298,52 @@ void espCommandDispatcher (void *pvParameters) {
       continue;
     }
 
-    input = Serial.readStringUntil('\n');
-    separatorIndex = input.indexOf(':');
+    length = Serial.readBytesUntil('\n', input, sizeof(input) - 1);
+    input[length] = '\0';
+    separator = strchr(input, ':');
 
-    if (separatorIndex == -1) {
+    if (separator == NULL) {
       continue;
     }
 
     //down here only when receive valid ESP command
-    label = input.substring(0, separatorIndex);
-    value = input.substring(separatorIndex + 1);
-    value.trim();
-
-    if(label.equals("USER")) {
-      char msg[15];
-      value.toCharArray(msg, sizeof(msg));
-      result = xQueueOverwrite(usernameQueue, msg);
-      if(result == errQUEUE_FULL){
-        Serial.println("[espCommandDispatcher] Fail to overwrite usernameQueue");
-      }
+    *separator = '\0';
+    label = input;
+    value = trimString(separator + 1);
+
+    if(strcmp(label, "USER") == 0) {
+      UserName userName;
+      SPS_Format(userName.name, sizeof(userName.name)).appendString(value);
+      userNameTopic.publish(userName);
     } 
 
-    if(label.equals("CHECKING-RESULT")){
-      int valueToInt = value.toInt();
+    if(strcmp(label, "CHECKING-RESULT") == 0){
+      int valueToInt = atoi(value);
       if(valueToInt == ENTRY_VALID_CARD 
         || valueToInt == ENTRY_INVALID_CARD
         || valueToInt == EXIT_VALID_CARD
         || valueToInt == EXIT_INVALID_CARD
-        || valueToInt == REQUEST_FAIL)
+        || valueToInt == ENTRY_REQUEST_FAIL
+        || valueToInt == EXIT_REQUEST_FAIL)
       {
-        // send to displayManager
-        result = xQueueOverwrite(scannedCardStateQueue, &valueToInt);
-        if(result == errQUEUE_FULL){
-          Serial.println("[espCommandDispatcher] Fail to overwrite scannedCardStateQueue");
-        }
-      }
-
-      // send to gateController
-      if(valueToInt == ENTRY_VALID_CARD){
-        xSemaphoreGive(entryGateCardDetectedConsumedByGateCtrl);
-        xSemaphoreGive(entryGateCardDetectedConsumedByRFIDScanDecisionUnit);
-      }
-
-      if(valueToInt == EXIT_VALID_CARD){
-        xSemaphoreGive(exitGateCardDetectedConsumedByGateCtrl);
-        xSemaphoreGive(exitGateCardDetectedConsumedByRFIDScanDecisionUnit);
+        // displayManager, gateController and rfidScanDecisionUnit
+        CardVerdict verdict = { valueToInt };
+        cardVerdictTopic.publish(verdict);
       }
     }  
   }
 }
 
-void printTime(String taskName, String startTime, String time, String time2){
-  Serial.println("[LOG] " + taskName + ": "+ startTime + " µs " + time + " µs " + time2 + " µs ");
+void printTime(const char *taskName, unsigned long startTime, unsigned long time, unsigned long time2){
+  Serial.print("[LOG] ");
+  Serial.print(taskName);
+  Serial.print(": ");
+  Serial.print(startTime);
+  Serial.print(" µs ");
+  Serial.print(time);
+  Serial.print(" µs ");
+  Serial.print(time2);
+  Serial.println(" µs ");
   vTaskDelay(100 / portTICK_PERIOD_MS);
 }
 void signalReader(void *pvParameters) {
@@ -283,10 +358,6 @@ void signalReader(void *pvParameters) {
       int value = infraredSensor.isParkingSensorDetected(i) ? 1 : 0;
       appendBit(slotStates, value);
     }
-    int result = xQueueOverwrite(slotStatesQueue, &slotStates);
-    if(result == errQUEUE_FULL){
-      Serial.println("[signalReader] Fail to overwrite slotStatesQueue");
-    }
 
     // read sensor around gates
     gateState = 0;
@@ -296,117 +367,144 @@ void signalReader(void *pvParameters) {
     appendBit(gateState, infraredSensor.isExitFrontSensorDetected());
     appendBit(gateState, infraredSensor.isExitBackSensorDetected());
     appendBit(gateState, digitalRead(EXIT_BTN_PIN));
-    result = xQueueOverwrite(gateSignalQueue, &gateState);
-    if(result == errQUEUE_FULL){
-      Serial.println("[signalReader] Fail to overwrite gateSignalQueue");
-    }
 
     //read light sensor
     lightState = digitalRead(LIGHT_SENSOR_PIN);
 
-    result = xQueueOverwrite(lightStateQueue, &lightState);
-    if(result == errQUEUE_FULL){
-      Serial.println("[signalReader] Fail to overwrite lightStateQueue");
-    }
+    sensorSnapshot.publish(slotStates, gateState, lightState);
   }
 }
 
 void rfidReader(void *pvParameters) {
+  int cardIndex;
+
+#ifdef RFID_BENCHMARK
+  unsigned long lastReportTime = millis();
+#endif
+
   while(1) {
-    // read RFID card
-    bool isDetected = entryScanner.validateCard();
-    if(!entryScanner.hasSend && isDetected) {
-      int result = xQueueOverwrite(scannedCardInfoQueue, &(entryScanner.scannedCardIndex));
-      if(result == errQUEUE_FULL){
-        Serial.println("[rfidReader] Fail to overwrite cardInforQueue");
-      }
+    // read RFID card, one event per presentation
+    if(entryScanner.readCardEvent(cardIndex) && cardIndex != -1) {
+      CardRead cardRead = { cardIndex };
+      cardReadTopic.publish(cardRead);
+    }
 
-      entryScanner.hasSend = true;
+#ifdef RFID_BENCHMARK
+    if(millis() - lastReportTime >= 1000){
+      SPS_RFID_Scanner::Stats stats = entryScanner.takeStats();
+      lastReportTime = millis();
+
+      Serial.print("[RFID] polls/s: ");
+      Serial.print(stats.polls * 1000 / stats.elapsedInMs);
+      Serial.print(" reads ok/total: ");
+      Serial.print(stats.readsSucceeded);
+      Serial.print("/");
+      Serial.print(stats.cardsPresent);
+      Serial.print(" suppressed: ");
+      Serial.print(stats.eventsSuppressed);
+      Serial.print(" REQA timeout: ");
+      Serial.print(entryScanner.getTimeout(SPS_RFID_Scanner::REQUEST_PROFILE));
+      Serial.print(" us SELECT timeout: ");
+      Serial.print(entryScanner.getTimeout(SPS_RFID_Scanner::SELECT_PROFILE));
+      Serial.println(" us");
     }
+#endif
   }
 }
 
 void displayManager(void *pvParameters) {
-  int slotStates = 0, cardState = UNDETECTED, result;
-  char username[15] = "", displayedText[30];
+  int slotStates = 0, cardState = UNDETECTED;
+  bool hasCardState, hasUsername = false;
+  SPS_SensorSnapshot::Values sensors = {};
+  CardVerdict verdict;
+  CardCheck cardCheck;
+  UserName userName;
+  char displayedText[30];
+#ifdef DISPLAY_BENCHMARK
+  unsigned long lastReportTime = millis();
+#endif
 
   while(1){
-    result = xQueueReceive(scannedCardStateQueue, &cardState, 0);
-    if (result == pdTRUE) {
-      display.clearScreen();
-
-      if (cardState == ENTRY_VALID_CARD 
-        || cardState == ENTRY_INVALID_CARD
-        || cardState == EXIT_VALID_CARD
-        || cardState == EXIT_INVALID_CARD
-        || cardState == REQUEST_FAIL) {
-        //start counting if result arrived
-        memset(username, 0, sizeof(username));
-        memset(displayedText, 0, sizeof(displayedText));
-        username[0] = '\0';
-        displayedText[0] = '\0';
-      }
+    // the ESP sends USER before the verdict it belongs to, keep the latest
+    if (displayUserNames.receive(userName)) {
+      hasUsername = true;
+    }
 
-      if (cardState == ENTRY_VALID_CARD )
-      {
-        strcat(displayedText, "Hi ");
-      }
-      if (cardState == EXIT_VALID_CARD) 
-      {
-        strcat(displayedText, "Bye ");
-      }
+    hasCardState = false;
+    if (displayCardVerdicts.receive(verdict)) {
+      cardState = verdict.result;
+      hasCardState = true;
+    } else if (displayCardChecks.receive(cardCheck)) {
+      cardState = cardCheck.gate == ENTRY_GATE ? ENTRY_CHECKING_CARD : EXIT_CHECKING_CARD;
+      hasCardState = true;
     }
     vTaskPrioritySet(displayManagerHandle, 2);
 
-    // rendering`s main logic
-    if((cardState == ENTRY_VALID_CARD) || (cardState == EXIT_VALID_CARD))
-    {
-      if(xQueueReceive(usernameQueue, username, 0)){
-        strcat(displayedText, username);
-        strcat(displayedText, " !");
-      }
-      display.printString(displayedText);
-      vTaskDelay(2000 / portTICK_PERIOD_MS);
-
-      display.clearScreen();
-      cardState = UNDETECTED;
-
-    } else if((cardState == ENTRY_INVALID_CARD) || (cardState == EXIT_INVALID_CARD))
-    {
-      display.printString("Invalid card");
-      vTaskDelay(2000 / portTICK_PERIOD_MS);
+    // card results become timed overlays on their gate's region, the slot view keeps rendering
+    if (hasCardState) {
+      if ((cardState == ENTRY_VALID_CARD) || (cardState == EXIT_VALID_CARD))
+      {
+        SPS_Format text(displayedText, sizeof(displayedText));
+        text.appendString(cardState == ENTRY_VALID_CARD ? "Hi " : "Bye ");
+        if(hasUsername){
+          text.appendString(userName.name).appendString(" !");
+          hasUsername = false;
+        }
+        display.showOverlay(cardState == ENTRY_VALID_CARD ? SPS_Display::ENTRY_REGION : SPS_Display::EXIT_REGION,
+                            displayedText, RESULT_MESSAGE_PRIORITY, RESULT_MESSAGE_MS);
 
-      display.clearScreen();
-      cardState = UNDETECTED;
+      } else if((cardState == ENTRY_INVALID_CARD) || (cardState == EXIT_INVALID_CARD))
+      {
+        display.showOverlay(cardState == ENTRY_INVALID_CARD ? SPS_Display::ENTRY_REGION : SPS_Display::EXIT_REGION,
+                            "Invalid card", RESULT_MESSAGE_PRIORITY, RESULT_MESSAGE_MS);
 
-    } else if (cardState == CHECKING_CARD) 
-    {
-      display.printString("Scanning...");
+      } else if ((cardState == ENTRY_CHECKING_CARD) || (cardState == EXIT_CHECKING_CARD))
+      {
+        display.showOverlay(cardState == ENTRY_CHECKING_CARD ? SPS_Display::ENTRY_REGION : SPS_Display::EXIT_REGION,
+                            "Scanning...", CHECKING_MESSAGE_PRIORITY, CHECKING_MESSAGE_MS);
 
-    } else if(cardState == REQUEST_FAIL) 
-    {
-      display.printString("Fail to scan");
-      vTaskDelay(2000 / portTICK_PERIOD_MS);
+      } else if((cardState == ENTRY_REQUEST_FAIL) || (cardState == EXIT_REQUEST_FAIL))
+      {
+        // checks of both gates can be answered in any order, the code says which one failed
+        display.showOverlay(cardState == ENTRY_REQUEST_FAIL ? SPS_Display::ENTRY_REGION : SPS_Display::EXIT_REGION,
+                            "Fail to scan", RESULT_MESSAGE_PRIORITY, RESULT_MESSAGE_MS);
+      }
+    }
 
-      display.clearScreen();
-      cardState = UNDETECTED;
+    // rendering`s main logic
+    sensorSnapshot.read(sensors);
+    slotStates = sensors.slotStates;
+    display.render(getBitAt(slotStates, 5), getBitAt(slotStates, 4), getBitAt(slotStates, 3), 
+                   getBitAt(slotStates, 2), getBitAt(slotStates, 1), getBitAt(slotStates, 0));
+    vTaskPrioritySet(displayManagerHandle, 1);
 
-    } else {
-      xQueuePeek(slotStatesQueue, &slotStates, 0);
-      display.render(getBitAt(slotStates, 5), getBitAt(slotStates, 4), getBitAt(slotStates, 3), 
-                     getBitAt(slotStates, 2), getBitAt(slotStates, 1), getBitAt(slotStates, 0));
+#ifdef DISPLAY_BENCHMARK
+    if(millis() - lastReportTime >= 1000){
+      lastReportTime = millis();
+
+      Serial.print("[LCD] bytes/frame: ");
+      Serial.print(display.getLastFrameBytes());
+      Serial.print(" render time: ");
+      Serial.print(display.getLastRenderTime());
+      Serial.print(" us I2C time/frame: ");
+      Serial.print(display.getLastFrameI2CTime());
+      Serial.print(" us I2C time/s: ");
+      Serial.print(display.getI2CTimeLastSecond());
+      Serial.println(" us");
     }
-    vTaskPrioritySet(displayManagerHandle, 1);
+#endif
   }
 }
 
 void lightController(void *pvParameters) {
-  int lightState = 0;
+  SPS_SensorSnapshot::Values sensors = {};
 
   while(1) {
-    xQueuePeek(lightStateQueue, &lightState, 0);
+    if (!sensorSnapshot.readChanged(sensors)) {
+      continue;
+    }
 
-    if (lightState == HIGH) {
+    if (sensors.lightState == HIGH) {
       digitalWrite(LED_PIN, HIGH);
     } else {
       digitalWrite(LED_PIN, LOW);
@@ -424,94 +522,174 @@ void gateController(void *pvParameters) {
   bool currentExitGateStatus = 0;
   int gateState = 0;
   int slotState = 0;
+  bool entryCardAccepted = false;
+  bool exitCardAccepted = false;
+  SPS_SensorSnapshot::Values sensors = {};
+  CardVerdict verdict;
 
   while(1) {
-    xQueuePeek(gateSignalQueue, &gateState, 0);
-    xQueuePeek(slotStatesQueue, &slotState, 0);
+    sensorSnapshot.read(sensors);
+    gateState = sensors.gateStates;
+    slotState = sensors.slotStates;
+
+    // an accepted card stays pending until its gate opens
+    while (gateControllerCardVerdicts.receive(verdict)) {
+      if (verdict.result == ENTRY_VALID_CARD) {
+        entryCardAccepted = true;
+      } else if (verdict.result == EXIT_VALID_CARD) {
+        exitCardAccepted = true;
+      }
+    }
 
     // update gate status
     updateEntryGateStatus(entrySwitchLastState, entryMode, currentEntryGateStatus, 
               getBitAt(gateState, 5), getBitAt(gateState, 4), 
-              getBitAt(gateState, 3), slotState != TOTAL_SLOTS_BITS_TO_INT);
+              getBitAt(gateState, 3), slotState != TOTAL_SLOTS_BITS_TO_INT, entryCardAccepted);
  
     if (currentEntryGateStatus == OPEN) {
       entryGate.open();
     } else {
       entryGate.close();
     }
+    entryGate.update();
 
     updateExitGateStatus(exitSwitchLastState, exitMode, currentExitGateStatus, 
               getBitAt(gateState, 2), getBitAt(gateState, 1), 
-              getBitAt(gateState, 0));
+              getBitAt(gateState, 0), exitCardAccepted);
 
     if (currentExitGateStatus == OPEN) {
       exitGate.open();
     } else {
       exitGate.close();
     }
+    exitGate.update();
   }
 }
 
+#ifdef GATE_BENCHMARK
+void printGateMotion(SPS_Gate &gate, SPS_Gate::State state) {
+  Serial.print(&gate == &entryGate ? "[entryGate] " : "[exitGate] ");
+  Serial.print(state == SPS_Gate::OPEN_STATE ? "opened in " : "closed in ");
+  Serial.print(gate.getLastMotionTime());
+  Serial.println(" ms");
+}
+#endif
+
 void slotStatesChangeDetector (void *pvParameters) {
   int slotStates = 0;
   int newSlotStates = 0;
+  SPS_SensorSnapshot::Values sensors = {};
 
   while (1){
-    if(xQueuePeek(slotStatesQueue, &newSlotStates, 0)){
+    if(sensorSnapshot.readChanged(sensors)){
+      newSlotStates = sensors.slotStates;
       if(slotStates - newSlotStates != 0){ 
-        Serial.println("state change: " + (String)newSlotStates + " " + (String)slotStates);
+        Serial.print("state change: ");
+        Serial.print(newSlotStates);
+        Serial.print(" ");
+        Serial.println(slotStates);
         slotStates = newSlotStates;
-        int result = xQueueOverwrite(slotNewStatesQueue, &slotStates);
-        if(result == errQUEUE_FULL){
-          Serial.println("[slotStatesChangeDetector] Fail to overwrite slotNewStatesQueue");
-        }
+        SlotChanged slotChanged = { slotStates };
+        slotChangedTopic.publish(slotChanged);
       }
     }
   }
 }
 
+#ifdef QUEUE_DIAGNOSTICS
+void printMailboxStats(const char *name, SPS_MailboxStats stats) {
+  Serial.print("[EventBus] ");
+  Serial.print(name);
+  Serial.print(" delivered: ");
+  Serial.print(stats.delivered);
+  Serial.print(" dropped: ");
+  Serial.print(stats.overflows);
+  Serial.print(" coalesced: ");
+  Serial.print(stats.coalesced);
+  Serial.print(" high water: ");
+  Serial.print(stats.highWaterMark);
+  Serial.print("/");
+  Serial.print(stats.capacity);
+  Serial.print(" latency last/max: ");
+  Serial.print(stats.lastLatency);
+  Serial.print("/");
+  Serial.print(stats.maxLatency);
+  Serial.println(" us");
+}
+#endif
+
 void espCommandProducer (void *pvParameters) {
-  int slotStates;
-  int cardMixGate = -1;
+  CardCheck cardCheck;
+  SlotChanged slotChanged;
+#ifdef QUEUE_DIAGNOSTICS
+  unsigned long lastReportTime = millis();
+#endif
 
   while (1){
-    if(xQueueReceive(cardWithSpecificGateQueue, &cardMixGate, 0)){
-      int gate = getBitAt(cardMixGate, 0); // get the last bit which is gate value
-      truncateNBitsEnd(cardMixGate, 1); // truncate the last bit to get the proper cardIndex
+    if(espProducerCardChecks.receive(cardCheck)){
+      printGateAndCardToSerial(cardCheck.cardIndex, cardCheck.gate);
+    }
 
-      printGateAndCardToSerial(cardMixGate, gate);
-      cardMixGate = -1;
+    if(espProducerSlotChanges.receive(slotChanged)){
+      printParkingStatesToSerial(slotChanged.slotStates);
     }
 
-    if(xQueueReceive(slotNewStatesQueue, &slotStates, 0)){
-      printParkingStatesToSerial(slotStates);
+#ifdef QUEUE_DIAGNOSTICS
+    if(millis() - lastReportTime >= 1000){
+      lastReportTime = millis();
+
+      printMailboxStats("decisionUnitCardReads", decisionUnitCardReads.takeStats());
+      printMailboxStats("espProducerCardChecks", espProducerCardChecks.takeStats());
+      printMailboxStats("displayCardChecks", displayCardChecks.takeStats());
+      printMailboxStats("displayCardVerdicts", displayCardVerdicts.takeStats());
+      printMailboxStats("gateControllerCardVerdicts", gateControllerCardVerdicts.takeStats());
+      printMailboxStats("decisionUnitCardVerdicts", decisionUnitCardVerdicts.takeStats());
+      printMailboxStats("espProducerSlotChanges", espProducerSlotChanges.takeStats());
+      printMailboxStats("displayUserNames", displayUserNames.takeStats());
+#ifdef LCD_ASYNC_TWI
+      Serial.print("[AsyncTWI] high water: ");
+      Serial.print(AsyncTWI.getHighWaterMark());
+      Serial.print("/");
+      Serial.print(SPS_AsyncTWI::QUEUE_LENGTH);
+      Serial.print(" full waits: ");
+      Serial.print(AsyncTWI.getFullWaitCount());
+      Serial.print(" errors: ");
+      Serial.print(AsyncTWI.getErrorCount());
+      Serial.print(" resets: ");
+      Serial.println(AsyncTWI.getResetCount());
+#endif
     }
+#endif
   }
 }
 
 void rfidScanDecisionUnit (void *pvParameters) {
-  int cardIndex;
   int gateSensorStates = 0;
   int gate = -1;
-  int result;
+  CardRead cardRead;
+  CardVerdict verdict;
   bool entryGateUnopen = true;
   bool exitGateUnopen = true;
   int slotState;
+  SPS_SensorSnapshot::Values sensors = {};
 
   while (1){
-    xQueuePeek(gateSignalQueue,&gateSensorStates, 0);
-    xQueuePeek(slotStatesQueue, &slotState, 0);
+    sensorSnapshot.read(sensors);
+    gateSensorStates = sensors.gateStates;
+    slotState = sensors.slotStates;
     // bit 5th is the value of sensor which is futher to the parkinglot at the entry gate
     // bit 4th is the value of sensor which is closer to the parkinglot at the entry gate
     // bit 2nd is the value of sensor which is closer to the parkinglot at the exit gate
     // bit 1nd is the value of sensor which is futher to the parkinglot at the exit gate
 
     // if that gate's barrier is open, that side is unscannable 
-    if(xSemaphoreTake(entryGateCardDetectedConsumedByRFIDScanDecisionUnit, 0) == pdTRUE){
-      entryGateUnopen = false; 
-    }
-    if(xSemaphoreTake(exitGateCardDetectedConsumedByRFIDScanDecisionUnit, 0) == pdTRUE){
-      exitGateUnopen = false; 
+    while(decisionUnitCardVerdicts.receive(verdict)){
+      if(verdict.result == ENTRY_VALID_CARD){
+        entryGateUnopen = false; 
+      }
+      if(verdict.result == EXIT_VALID_CARD){
+        exitGateUnopen = false; 
+      }
     }
     // if both sensors of that gate detects not thing, that side will return to scannable 
     if(!entryGateUnopen 
@@ -549,81 +727,88 @@ void rfidScanDecisionUnit (void *pvParameters) {
     }
 
     if((gate == ENTRY_GATE) && (slotState == TOTAL_SLOTS_BITS_TO_INT)){
-      xQueueReceive(scannedCardInfoQueue,&cardIndex, 0);
+      decisionUnitCardReads.receive(cardRead);
       continue;
     }
 
-    if(xQueueReceive(scannedCardInfoQueue,&cardIndex, 0)
+    if(decisionUnitCardReads.receive(cardRead)
       && (entryGateUnopen || exitGateUnopen)
       && (gate != -1))
     { // productRFIDFusion: run in here if card is detected and entry gate`s front Sensor or exit gate`s front Sensor detected signal
-      appendBit(cardIndex, gate); // append the gate value to the end of cardIndex's bits
-      result = xQueueSend(cardWithSpecificGateQueue, &cardIndex, portMAX_DELAY);
-      if(result == errQUEUE_FULL){
-        Serial.println("[rfidScanDecisionUnit] Fail to overwrite cardWithSpecificGateQueue");
-      }
-      
-      // displayManager: only sent if queue is empty
-      if (uxQueueMessagesWaiting(scannedCardStateQueue) == 0){
-        int cardState = CHECKING_CARD;
-        int result = xQueueOverwrite(scannedCardStateQueue, &cardState);
-        if(result == errQUEUE_FULL){
-          Serial.println("[rfidScanDecisionUnit] Fail to overwrite scannedCardStateQueue");
-        }
-      }
+      // espCommandProducer sends it to the ESP, displayManager shows the checking message
+      CardCheck cardCheck = { cardRead.cardIndex, gate };
+      cardCheckTopic.publish(cardCheck);
     }
   }
 }
 
+#ifdef SNAPSHOT_BENCHMARK
+void benchmarkSensorSnapshot() {
+  const long rounds = 1000;
+  int value = 0;
+  SPS_SensorSnapshot snapshot;
+  SPS_SensorSnapshot::Values sensors = {};
+
+  // the old way: one single slot queue per value
+  QueueHandle_t queue = xQueueCreate(1, sizeof(int));
+  unsigned long start = micros();
+  for (long i = 0; i < rounds; i++) {
+    value = i;
+    xQueueOverwrite(queue, &value);
+    xQueuePeek(queue, &value, 0);
+  }
+  unsigned long queueTime = micros() - start;
+  vQueueDelete(queue);
+
+  // one snapshot carries all three values
+  start = micros();
+  for (long i = 0; i < rounds; i++) {
+    snapshot.publish(i, i, i);
+    snapshot.read(sensors);
+  }
+  unsigned long snapshotTime = micros() - start;
+
+  Serial.print("[Snapshot] queue overwrite+peek: ");
+  Serial.print(queueTime * 1000 / rounds);
+  Serial.print(" ns snapshot publish+read: ");
+  Serial.print(snapshotTime * 1000 / rounds);
+  Serial.println(" ns");
+}
+#endif
+
 void setup() {
   Serial.begin(9600);
+#ifdef SNAPSHOT_BENCHMARK
+  benchmarkSensorSnapshot();
+#endif
 
   pinMode(ENTRY_BTN_PIN, INPUT_PULLUP);
   pinMode(EXIT_BTN_PIN, INPUT_PULLUP);
   pinMode(LIGHT_SENSOR_PIN, INPUT);
   pinMode(LED_PIN, OUTPUT);
 
-  // Allocate memory for each row and populate the array
-  validUIDs[0] = new unsigned char[4]{ 0x6D, 0xE2, 0xD7, 0x21 };  // Thẻ 1
-  validUIDs[1] = new unsigned char[4]{ 0x23, 0x0A, 0x54, 0x11 };  // Thẻ 2
-  validUIDs[2] = new unsigned char[4]{ 0xE3, 0x9A, 0x66, 0x10 };  // Thẻ 3
-  validUIDs[3] = new unsigned char[4]{ 0x43, 0x34, 0x54, 0x10 };  // Thẻ 4
-  validUIDs[4] = new unsigned char[4]{ 0x40, 0x1E, 0x4A, 0x12 };  // Thẻ 5
-  validUIDs[5] = new unsigned char[4]{ 0x6A, 0xD5, 0x17, 0xA4 };  // Thẻ 6
-
   infraredSensor.init();
-  display.init();
-  entryGate.init();
+  display.init(LCD_BUSY_POLLING);
+  display.setI2CBudget(LCD_I2C_BUDGET_US);
+  entryGate.init(GATE_SERVO_BACKEND);
+  entryGate.setMotionProfile(GATE_SPEED, GATE_ACCELERATION);
   entryScanner.init(validUIDs, 6);
-  exitGate.init(); 
-
-  slotStatesQueue = xQueueCreate(1, sizeof(int));
-  slotNewStatesQueue = xQueueCreate(1, sizeof(int));
-  usernameQueue = xQueueCreate(1, sizeof(char[15]));
-  scannedCardStateQueue = xQueueCreate(1, sizeof(int));
-  gateSignalQueue = xQueueCreate(1, sizeof(int));
-  lightStateQueue = xQueueCreate(1, sizeof(int));
-  scannedCardInfoQueue = xQueueCreate(1, sizeof(int));
-  cardWithSpecificGateQueue = xQueueCreate(10, sizeof(int));
-
-  entryGateCardDetectedConsumedByRFIDScanDecisionUnit = xSemaphoreCreateBinary();
-  exitGateCardDetectedConsumedByRFIDScanDecisionUnit = xSemaphoreCreateBinary();
-  entryGateCardDetectedConsumedByGateCtrl = xSemaphoreCreateBinary();
-  exitGateCardDetectedConsumedByGateCtrl = xSemaphoreCreateBinary();
-
-  if(entryGateCardDetectedConsumedByRFIDScanDecisionUnit == NULL
-    || exitGateCardDetectedConsumedByRFIDScanDecisionUnit == NULL
-    || entryGateCardDetectedConsumedByGateCtrl == NULL
-    || exitGateCardDetectedConsumedByGateCtrl == NULL
-  ){
-    Serial.println("[SetUp] Fail to create semaphore");
-    return;
-  }
+  entryScanner.setSuppressionWindows(RFID_VALID_CARD_WINDOW_MS, RFID_INVALID_CARD_WINDOW_MS);
+  exitGate.init(GATE_SERVO_BACKEND);
+  exitGate.setMotionProfile(GATE_SPEED, GATE_ACCELERATION);
+#ifdef GATE_BENCHMARK
+  entryGate.setMotionCallback(printGateMotion);
+  exitGate.setMotionCallback(printGateMotion);
+#endif
 
   xTaskCreate(espCommandDispatcher, "Task1", 300, NULL, 1, NULL);
   xTaskCreate(signalReader, "Task2", 300, NULL, 1, NULL);
   xTaskCreate(rfidReader, "Task3", 300, NULL, 1, NULL);
   xTaskCreate(displayManager, "Task4", 300, NULL, 1, &displayManagerHandle);
+#ifdef LCD_ASYNC_TWI
+  // the display task sleeps on LCD transfers instead of spinning
+  AsyncTWI.setOwner(displayManagerHandle);
+#endif
   xTaskCreate(lightController, "Task5", 300, NULL, 1, NULL);
   xTaskCreate(gateController, "Task6", 300, NULL, 1, NULL);
   xTaskCreate(slotStatesChangeDetector, "Task7", 300, NULL, 1, NULL);
@@ -0,0 +1,358 @@
+#include "SPS_AsyncHTTP.h"
+
+SPS_AsyncHTTP::SPS_AsyncHTTP(const char *host, uint16_t port,
+                             const char *token)
+    : host(host), port(port), token(token) {
+  for (uint8_t i = 0; i < POOL_SIZE; i++) {
+    Slot &slot = slots[i];
+    slot.owner = this;
+    slot.state = IDLE;
+    slot.keepAlive = false;
+    slot.client.onConnect(connectHandler, &slot);
+    slot.client.onData(dataHandler, &slot);
+    // also called after an error, with the connection already gone
+    slot.client.onDisconnect(disconnectHandler, &slot);
+  }
+}
+
+bool SPS_AsyncHTTP::request(const char *method, const char *path,
+                            const char *body, unsigned long timeoutInMs,
+                            ResponseCallback callback, int tag) {
+  // a free slot with an open connection saves the TCP handshake
+  Slot *chosen = NULL;
+  for (uint8_t i = 0; i < POOL_SIZE; i++) {
+    Slot &slot = slots[i];
+    if (slot.state != IDLE) {
+      continue;
+    }
+    if (slot.keepAlive && slot.client.connected()) {
+      chosen = &slot;
+      break;
+    }
+    if (chosen == NULL) {
+      chosen = &slot;
+    }
+  }
+  if (chosen == NULL) {
+    return false;
+  }
+  Slot &slot = *chosen;
+
+  int length;
+  if (body != NULL) {
+    length = snprintf(slot.request, sizeof(slot.request),
+                      "%s %s HTTP/1.1\r\nHost: %s:%u\r\n"
+                      "Connection: keep-alive\r\n"
+                      "%s%s%s"
+                      "Content-Type: application/json\r\n"
+                      "Content-Length: %u\r\n\r\n%s",
+                      method, path, host, port,
+                      token ? "Authorization: Bearer " : "", token ? token : "",
+                      token ? "\r\n" : "", (unsigned)strlen(body), body);
+  } else {
+    length = snprintf(slot.request, sizeof(slot.request),
+                      "%s %s HTTP/1.1\r\nHost: %s:%u\r\n"
+                      "Connection: keep-alive\r\n"
+                      "%s%s%s\r\n",
+                      method, path, host, port,
+                      token ? "Authorization: Bearer " : "", token ? token : "",
+                      token ? "\r\n" : "");
+  }
+  if (length < 0 || length >= (int)sizeof(slot.request)) {
+    return false;
+  }
+  slot.requestLength = length;
+
+  slot.response.code = 0;
+  slot.response.body = slot.body;
+  slot.response.connectTime = 0;
+  slot.response.sendTime = 0;
+  slot.response.waitTime = 0;
+  slot.requestTime = millis();
+  slot.timeout = timeoutInMs;
+  slot.callback = callback;
+  slot.tag = tag;
+  slot.retried = false;
+
+  if (slot.keepAlive && slot.client.connected()) {
+    slot.reused = true;
+    send(slot);
+  } else {
+    connect(slot);
+  }
+  return true;
+}
+
+void SPS_AsyncHTTP::update() {
+  for (uint8_t i = 0; i < POOL_SIZE; i++) {
+    Slot &slot = slots[i];
+
+    if (slot.state == RECONNECT) {
+      slot.retried = true;
+      connect(slot);
+    }
+
+    if ((slot.state == CONNECTING || slot.state == WAITING) &&
+        millis() - slot.requestTime >= slot.timeout) {
+      slot.keepAlive = false;
+      finish(slot, TIMEOUT_ERROR);
+    }
+
+    if (slot.state != COMPLETE) {
+      continue;
+    }
+
+    // the slot is free before the callback so it can start a new request
+    slot.state = IDLE;
+    if (!slot.keepAlive) {
+      slot.client.close(true);
+    }
+    if (slot.callback != NULL) {
+      slot.callback(slot.response, slot.tag);
+    }
+  }
+}
+
+void SPS_AsyncHTTP::stop() {
+  for (uint8_t i = 0; i < POOL_SIZE; i++) {
+    Slot &slot = slots[i];
+    slot.keepAlive = false;
+
+    if (slot.state == CONNECTING || slot.state == RECONNECT ||
+        slot.state == WAITING) {
+      finish(slot, CONNECT_ERROR);
+    } else if (slot.state == IDLE) {
+      slot.client.close(true);
+    }
+  }
+}
+
+uint8_t SPS_AsyncHTTP::getInFlight() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < POOL_SIZE; i++) {
+    if (slots[i].state != IDLE) {
+      count++;
+    }
+  }
+  return count;
+}
+
+const char *SPS_AsyncHTTP::errorToString(int code) {
+  switch (code) {
+  case CONNECT_ERROR:
+    return "connection failed";
+  case SEND_ERROR:
+    return "send failed";
+  case TIMEOUT_ERROR:
+    return "read timeout";
+  case RESPONSE_ERROR:
+    return "invalid response";
+  case CLOSED_ERROR:
+    return "connection closed";
+  default:
+    return "unknown";
+  }
+}
+
+void SPS_AsyncHTTP::connect(Slot &slot) {
+  // a connection that is still closing keeps its pcb and refuses connect()
+  slot.state = IDLE;
+  slot.client.close(true);
+
+  slot.reused = false;
+  slot.keepAlive = true;
+  slot.state = CONNECTING;
+  slot.phaseStart = micros();
+  if (!slot.client.connect(host, port)) {
+    slot.keepAlive = false;
+    finish(slot, CONNECT_ERROR);
+  }
+}
+
+void SPS_AsyncHTTP::send(Slot &slot) {
+  slot.parse = STATUS_LINE;
+  slot.lineLength = 0;
+  slot.remaining = -1;
+  slot.chunked = false;
+  slot.received = 0;
+  slot.bodyLength = 0;
+  slot.keepAlive = true;
+
+  slot.state = WAITING;
+  slot.phaseStart = micros();
+  size_t written = slot.client.write(slot.request, slot.requestLength);
+  slot.response.sendTime = micros() - slot.phaseStart;
+  slot.phaseStart = micros();
+
+  if (written != slot.requestLength) {
+    slot.keepAlive = false;
+    finish(slot, SEND_ERROR);
+  }
+}
+
+void SPS_AsyncHTTP::finish(Slot &slot, int code) {
+  if (slot.state == CONNECTING) {
+    slot.response.connectTime = micros() - slot.phaseStart;
+  } else if (slot.state == WAITING) {
+    slot.response.waitTime = micros() - slot.phaseStart;
+  }
+
+  slot.body[slot.bodyLength] = '\0';
+  slot.response.code = code;
+  slot.state = COMPLETE;
+}
+
+void SPS_AsyncHTTP::onConnect(Slot &slot) {
+  if (slot.state != CONNECTING) {
+    return;
+  }
+  slot.response.connectTime = micros() - slot.phaseStart;
+  slot.client.setNoDelay(true);
+  send(slot);
+}
+
+void SPS_AsyncHTTP::onData(Slot &slot, const char *data, size_t length) {
+  if (slot.state != WAITING) {
+    return;
+  }
+  slot.received += length;
+
+  for (size_t i = 0; i < length && slot.parse != DONE; i++) {
+    char c = data[i];
+
+    switch (slot.parse) {
+    case BODY:
+    case CHUNK_DATA:
+      storeBody(slot, c);
+      if (--slot.remaining == 0) {
+        slot.parse = slot.parse == BODY ? DONE : CHUNK_END;
+      }
+      break;
+
+    case UNTIL_CLOSE:
+      storeBody(slot, c);
+      break;
+
+    default:
+      // status, header and chunk framing lines
+      if (c == '\r') {
+        break;
+      }
+      if (c != '\n') {
+        if (slot.lineLength < sizeof(slot.line) - 1) {
+          slot.line[slot.lineLength++] = c;
+        }
+        break;
+      }
+      slot.line[slot.lineLength] = '\0';
+      slot.lineLength = 0;
+      if (!parseLine(slot)) {
+        slot.keepAlive = false;
+        finish(slot, RESPONSE_ERROR);
+        return;
+      }
+      break;
+    }
+  }
+
+  if (slot.parse == DONE) {
+    finish(slot, slot.response.code);
+  }
+}
+
+void SPS_AsyncHTTP::onClose(Slot &slot) {
+  slot.keepAlive = false;
+
+  if (slot.state == CONNECTING) {
+    finish(slot, CONNECT_ERROR);
+  } else if (slot.state == WAITING) {
+    if (slot.parse == UNTIL_CLOSE) {
+      finish(slot, slot.response.code);
+    } else if (slot.reused && slot.received == 0 && !slot.retried) {
+      // the server closed the idle connection just before our request
+      slot.state = RECONNECT;
+    } else {
+      finish(slot, CLOSED_ERROR);
+    }
+  }
+}
+
+bool SPS_AsyncHTTP::parseLine(Slot &slot) {
+  const char *line = slot.line;
+
+  switch (slot.parse) {
+  case STATUS_LINE:
+    if (strncmp(line, "HTTP/1.", 7) != 0) {
+      return false;
+    }
+    slot.response.code = atoi(line + 9);
+    slot.keepAlive = line[7] == '1';
+    slot.parse = HEADER_LINE;
+    return true;
+
+  case HEADER_LINE:
+    if (line[0] != '\0') {
+      if (strncasecmp(line, "Content-Length:", 15) == 0) {
+        slot.remaining = atol(line + 15);
+      } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+        slot.chunked = strstr(line + 18, "chunked") != NULL;
+      } else if (strncasecmp(line, "Connection:", 11) == 0) {
+        slot.keepAlive = strstr(line + 11, "close") == NULL;
+      }
+      return true;
+    }
+
+    if (slot.response.code == 204 || slot.response.code == 304) {
+      slot.parse = DONE;
+    } else if (slot.chunked) {
+      slot.parse = CHUNK_SIZE;
+    } else if (slot.remaining >= 0) {
+      slot.parse = slot.remaining == 0 ? DONE : BODY;
+    } else {
+      // neither length nor chunks: the body ends when the server closes
+      slot.keepAlive = false;
+      slot.parse = UNTIL_CLOSE;
+    }
+    return true;
+
+  case CHUNK_SIZE:
+    slot.remaining = strtol(line, NULL, 16);
+    slot.parse = slot.remaining == 0 ? TRAILER : CHUNK_DATA;
+    return true;
+
+  case CHUNK_END:
+    slot.parse = CHUNK_SIZE;
+    return line[0] == '\0';
+
+  case TRAILER:
+    if (line[0] == '\0') {
+      slot.parse = DONE;
+    }
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+void SPS_AsyncHTTP::storeBody(Slot &slot, char c) {
+  if (slot.bodyLength < sizeof(slot.body) - 1) {
+    slot.body[slot.bodyLength++] = c;
+  }
+}
+
+void SPS_AsyncHTTP::connectHandler(void *arg, AsyncClient *client) {
+  Slot &slot = *(Slot *)arg;
+  slot.owner->onConnect(slot);
+}
+
+void SPS_AsyncHTTP::dataHandler(void *arg, AsyncClient *client, void *data,
+                                size_t length) {
+  Slot &slot = *(Slot *)arg;
+  slot.owner->onData(slot, (const char *)data, length);
+}
+
+void SPS_AsyncHTTP::disconnectHandler(void *arg, AsyncClient *client) {
+  Slot &slot = *(Slot *)arg;
+  slot.owner->onClose(slot);
+}
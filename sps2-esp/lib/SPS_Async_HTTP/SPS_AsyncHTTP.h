@@ -0,0 +1,159 @@
+#ifndef SPS_AsyncHTTP_H
+#define SPS_AsyncHTTP_H
+
+#include <Arduino.h>
+#include <ESPAsyncTCP.h>
+
+/**
+ * Event driven HTTP/1.1 client for one server. Up to POOL_SIZE requests are
+ * in flight at the same time, each on its own kept-alive connection.
+ *
+ * The TCP callbacks only parse into the request's slot, the response callback
+ * runs from update() so it may print and start new requests
+ */
+class SPS_AsyncHTTP {
+public:
+  enum {
+    POOL_SIZE = 4,
+    REQUEST_SIZE = 640, // headers with a 64 character token and body
+    BODY_SIZE = 384 // longer bodies are cut, the rest is read and dropped
+  };
+
+  // negative response codes, a positive code is the HTTP status
+  enum Error {
+    CONNECT_ERROR = -1,
+    SEND_ERROR = -2,
+    TIMEOUT_ERROR = -3,
+    RESPONSE_ERROR = -4,
+    CLOSED_ERROR = -5 // the server closed the connection mid response
+  };
+
+  struct Response {
+    int code;         // HTTP status or an Error
+    const char *body; // null terminated, valid until the callback returns
+    // time spent in each step in µs, connectTime is 0 when a kept-alive
+    // connection was reused
+    unsigned long connectTime;
+    unsigned long sendTime;
+    unsigned long waitTime;
+  };
+
+  /**
+   * @param   response    only valid during the call
+   * @param   tag         the value given to request()
+   */
+  typedef void (*ResponseCallback)(const Response &response, int tag);
+
+  /**
+   * @param   host        server address, the string must outlive the client
+   * @param   port        server port
+   * @param   token       sent as a bearer token with every request when not
+   *                      NULL, the string must outlive the client too
+   */
+  SPS_AsyncHTTP(const char *host, uint16_t port, const char *token = NULL);
+
+  /**
+   * start a request and return right away
+   * @param   method      GET, PUT, POST...
+   * @param   path        path and query, already encoded
+   * @param   body        JSON body or NULL
+   * @param   timeoutInMs time from request() to the whole response
+   * @param   callback    called once from update() with the response or error
+   * @param   tag         passed to callback untouched
+   * @return  false when every slot is busy or the request does not fit,
+   *          callback is not called then
+   */
+  bool request(const char *method, const char *path, const char *body,
+               unsigned long timeoutInMs, ResponseCallback callback, int tag);
+
+  /**
+   * deliver finished responses, expire timed out requests and reconnect
+   * dropped ones, call it from loop()
+   */
+  void update();
+
+  /**
+   * close every connection, requests in flight fail with CONNECT_ERROR on the
+   * next update()
+   */
+  void stop();
+
+  /**
+   * @return  number of requests started and not yet delivered
+   */
+  uint8_t getInFlight();
+
+  static const char *errorToString(int code);
+
+private:
+  enum SlotState {
+    IDLE,       // free, the connection may still be open for reuse
+    CONNECTING, // request formatted, waiting for the connection
+    RECONNECT,  // a reused connection was dropped before any answer
+    WAITING,    // request written, reading the response
+    COMPLETE    // response or error ready for update()
+  };
+
+  enum ParseState {
+    STATUS_LINE,
+    HEADER_LINE,
+    BODY,
+    CHUNK_SIZE,
+    CHUNK_DATA,
+    CHUNK_END,
+    TRAILER,
+    UNTIL_CLOSE,
+    DONE
+  };
+
+  struct Slot {
+    SPS_AsyncHTTP *owner;
+    AsyncClient client;
+    SlotState state;
+    bool reused;
+    bool retried;
+    bool keepAlive;
+
+    char request[REQUEST_SIZE];
+    size_t requestLength;
+
+    ParseState parse;
+    char line[128];
+    size_t lineLength;
+    long remaining;
+    bool chunked;
+    size_t received;
+    char body[BODY_SIZE];
+    size_t bodyLength;
+
+    Response response;
+    unsigned long requestTime; // millis
+    unsigned long timeout;
+    unsigned long phaseStart; // micros
+    ResponseCallback callback;
+    int tag;
+  };
+
+  const char *host;
+  uint16_t port;
+  const char *token;
+  Slot slots[POOL_SIZE];
+
+  void connect(Slot &slot);
+  void send(Slot &slot);
+  void finish(Slot &slot, int code);
+  void onConnect(Slot &slot);
+  void onData(Slot &slot, const char *data, size_t length);
+  void onClose(Slot &slot);
+  bool parseLine(Slot &slot);
+  void storeBody(Slot &slot, char c);
+
+  // ESPAsyncTCP callbacks, arg is the Slot. They run between two loop()
+  // calls, never in the middle of one
+  static void connectHandler(void *arg, AsyncClient *client);
+  static void dataHandler(void *arg, AsyncClient *client, void *data,
+                          size_t length);
+  static void disconnectHandler(void *arg, AsyncClient *client);
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "SPS_BridgeChannel.h"
+
+SPS_BridgeChannel::SPS_BridgeChannel(const char *host, uint16_t port,
+                                     const char *token)
+    : host(host), port(port), token(token), joining(false), joined(false),
+      joinId(0), rejectedAt(0), nextId(0), pushCallback(NULL) {
+  for (uint8_t i = 0; i < MAX_PENDING; i++) {
+    pending[i].used = false;
+  }
+}
+
+void SPS_BridgeChannel::begin(PushCallback callback) {
+  pushCallback = callback;
+  socketIO.onEvent([this](socketIOmessageType_t type, uint8_t *payload,
+                          size_t length) { onEvent(type, payload, length); });
+  socketIO.setReconnectInterval(RECONNECT_INTERVAL_MS);
+  // the handshake query carries the token, the server checks it on bridge:join
+  char url[96];
+  snprintf(url, sizeof(url), "/socket.io/?EIO=4&token=%s", token);
+  socketIO.begin(host, port, url);
+}
+
+void SPS_BridgeChannel::update(bool mayConnect) {
+  if (rejectedAt != 0 && millis() - rejectedAt >= REJECTED_BACKOFF_MS) {
+    rejectedAt = 0;
+  }
+
+  // loop() is where a reconnect blocks, a live connection always needs it
+  if ((mayConnect && rejectedAt == 0) || socketIO.isConnected()) {
+    socketIO.loop();
+  }
+
+  for (uint8_t i = 0; i < MAX_PENDING; i++) {
+    Pending &request = pending[i];
+    if (request.used && millis() - request.requestTime >= request.timeout) {
+      // a late answer finds no request with its id and is dropped
+      finish(request, SPS_AsyncHTTP::TIMEOUT_ERROR, "");
+    }
+  }
+}
+
+bool SPS_BridgeChannel::isConnected() { return joined; }
+
+bool SPS_BridgeChannel::isRejected() { return rejectedAt != 0; }
+
+bool SPS_BridgeChannel::request(const char *event, const char *payload,
+                                unsigned long timeoutInMs,
+                                SPS_AsyncHTTP::ResponseCallback callback,
+                                int tag) {
+  if (!joined) {
+    return false;
+  }
+
+  Pending *request = NULL;
+  for (uint8_t i = 0; i < MAX_PENDING; i++) {
+    if (!pending[i].used) {
+      request = &pending[i];
+      break;
+    }
+  }
+  if (request == NULL) {
+    return false;
+  }
+
+  // "<id>[<event>,<payload>]", sendEVENT adds the "42" packet type
+  uint32_t id = nextId;
+  int length = snprintf(message, sizeof(message), "%lu[\"%s\",%s]",
+                        (unsigned long)id, event, payload);
+  if (length < 0 || length >= (int)sizeof(message)) {
+    return false;
+  }
+
+  unsigned long start = micros();
+  if (!socketIO.sendEVENT(message, length)) {
+    return false;
+  }
+  nextId++;
+
+  request->used = true;
+  request->id = id;
+  request->requestTime = millis();
+  request->timeout = timeoutInMs;
+  request->sendTime = micros() - start;
+  request->phaseStart = micros();
+  request->callback = callback;
+  request->tag = tag;
+  return true;
+}
+
+void SPS_BridgeChannel::stop() {
+  socketIO.disconnect();
+  joining = false;
+  joined = false;
+  failAll(SPS_AsyncHTTP::CLOSED_ERROR);
+}
+
+uint8_t SPS_BridgeChannel::getPending() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < MAX_PENDING; i++) {
+    if (pending[i].used) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void SPS_BridgeChannel::onEvent(socketIOmessageType_t type, uint8_t *payload,
+                                size_t length) {
+  switch (type) {
+  case sIOtype_CONNECT:
+    if (length > 0 && payload[0] == '{') {
+      // {"sid": ...}: the server accepted the default namespace, the token
+      // is checked on bridge:join and requests wait for its acknowledgement
+      int joinLength = snprintf(message, sizeof(message),
+                                "%lu[\"bridge:join\"]", (unsigned long)nextId);
+      if (socketIO.sendEVENT(message, joinLength)) {
+        joinId = nextId++;
+        joining = true;
+      }
+    } else {
+      // the transport is up, socket.io v4 needs the namespace joined
+      socketIO.send(sIOtype_CONNECT, "/");
+    }
+    break;
+
+  case sIOtype_DISCONNECT:
+    if (joining) {
+      // the server disconnects right after refusing, its answer may be lost
+      reject();
+    }
+    joining = false;
+    joined = false;
+    failAll(SPS_AsyncHTTP::CLOSED_ERROR);
+    break;
+
+  case sIOtype_ACK:
+    onAck((char *)payload);
+    break;
+
+  case sIOtype_EVENT:
+    onPush((const char *)payload, length);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void SPS_BridgeChannel::onAck(char *payload) {
+  // "<id>[{...}]"
+  char *body;
+  uint32_t id = strtoul(payload, &body, 10);
+  if (joining && id == joinId) {
+    onJoinAck(body);
+    return;
+  }
+
+  Pending *request = NULL;
+  for (uint8_t i = 0; i < MAX_PENDING; i++) {
+    if (pending[i].used && pending[i].id == id) {
+      request = &pending[i];
+      break;
+    }
+  }
+  if (request == NULL) {
+    return;
+  }
+
+  // unwrap the argument list so the callback sees the object like a HTTP body
+  char *end = strrchr(body, ']');
+  if (*body != '[' || end == NULL) {
+    finish(*request, SPS_AsyncHTTP::RESPONSE_ERROR, "");
+    return;
+  }
+  body++;
+  *end = '\0';
+
+  // only the status is read, the body goes to the callback as it is
+  JsonDocument filter;
+  filter["status"] = true;
+  JsonDocument doc;
+  DeserializationError error =
+      deserializeJson(doc, (const char *)body, DeserializationOption::Filter(filter));
+  int status = error ? 0 : doc["status"].as<int>();
+  if (status <= 0) {
+    finish(*request, SPS_AsyncHTTP::RESPONSE_ERROR, "");
+    return;
+  }
+  finish(*request, status, body);
+}
+
+void SPS_BridgeChannel::onJoinAck(const char *body) {
+  // "[{"status":200}]"
+  joining = false;
+  JsonDocument doc;
+  if (!deserializeJson(doc, body) && doc[0]["status"].as<int>() == 200) {
+    joined = true;
+    return;
+  }
+  reject();
+  socketIO.disconnect();
+}
+
+void SPS_BridgeChannel::reject() { rejectedAt = max(millis(), 1UL); }
+
+void SPS_BridgeChannel::onPush(const char *payload, size_t length) {
+  if (pushCallback == NULL) {
+    return;
+  }
+
+  // ["<event>", {...}]
+  JsonDocument doc;
+  if (deserializeJson(doc, payload, length)) {
+    return;
+  }
+  const char *event = doc[0].as<const char *>();
+  if (event != NULL) {
+    pushCallback(event, doc[1]);
+  }
+}
+
+void SPS_BridgeChannel::finish(Pending &request, int code, const char *body) {
+  SPS_AsyncHTTP::Response response;
+  response.code = code;
+  response.body = body;
+  response.connectTime = 0;
+  response.sendTime = request.sendTime;
+  response.waitTime = micros() - request.phaseStart;
+
+  // the slot is free before the callback so it can start a new request
+  request.used = false;
+  if (request.callback != NULL) {
+    request.callback(response, request.tag);
+  }
+}
+
+void SPS_BridgeChannel::failAll(int code) {
+  for (uint8_t i = 0; i < MAX_PENDING; i++) {
+    if (pending[i].used) {
+      finish(pending[i], code, "");
+    }
+  }
+}
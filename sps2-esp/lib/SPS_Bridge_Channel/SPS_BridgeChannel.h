@@ -0,0 +1,135 @@
+#ifndef SPS_BridgeChannel_H
+#define SPS_BridgeChannel_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <SPS_AsyncHTTP.h>
+#include <SocketIOclient.h>
+
+/**
+ * Persistent socket.io connection to the web server. A request is an event
+ * with an acknowledgement id, the server answers it with
+ * {"status": <HTTP status>, ...} and the answer is handed over as a
+ * SPS_AsyncHTTP::Response, so the same callbacks serve both transports.
+ * Events the server pushes on its own go to the push callback.
+ *
+ * Everything runs from update(), callbacks may start new requests.
+ *
+ * The WebSockets library connects with a blocking WiFiClient: an attempt on
+ * an unreachable server stalls update() for the TCP connect timeout, 5 s on
+ * the ESP8266, and the handshake can wait WEBSOCKETS_TCP_TIMEOUT (5 s) more.
+ * So the channel only tries to connect while the caller says the server
+ * answers, see update(). The worst case is then one such stall when the server
+ * goes away between the caller's check and the attempt.
+ *
+ * The channel is only connected once the server acknowledged bridge:join,
+ * which it does after checking the token. A refused token keeps the channel
+ * from connecting again for REJECTED_BACKOFF_MS
+ */
+class SPS_BridgeChannel {
+public:
+  enum {
+    MAX_PENDING = 4,
+    MESSAGE_SIZE = 512,
+    RECONNECT_INTERVAL_MS = 2000,
+    REJECTED_BACKOFF_MS = 60000
+  };
+
+  /**
+   * @param   event       name of the pushed event
+   * @param   data        its first argument, only valid during the call
+   */
+  typedef void (*PushCallback)(const char *event, JsonVariantConst data);
+
+  /**
+   * @param   host        server address, the string must outlive the channel
+   * @param   port        server port
+   * @param   token       the server's BRIDGE_TOKEN, URL safe. The server only
+   *                      lets the channel join the bridge room with it
+   */
+  SPS_BridgeChannel(const char *host, uint16_t port, const char *token);
+
+  /**
+   * start connecting, the channel reconnects on its own after a drop
+   * @param   callback    called for every event the server pushes
+   */
+  void begin(PushCallback callback);
+
+  /**
+   * run the connection, deliver answers and expire requests, call it from
+   * loop()
+   * @param   mayConnect  false while the server is not known to answer, a
+   *                      lost connection is then not retried
+   */
+  void update(bool mayConnect);
+
+  /**
+   * @return  true once the server accepted the token, requests can be sent
+   */
+  bool isConnected();
+
+  /**
+   * @return  true while waiting REJECTED_BACKOFF_MS after the server refused
+   *          the token
+   */
+  bool isRejected();
+
+  /**
+   * send an event and return right away
+   * @param   event       event name
+   * @param   payload     JSON object sent as the event's argument
+   * @param   timeoutInMs time from request() to the answer
+   * @param   callback    called once from update() with the answer or error
+   * @param   tag         passed to callback untouched
+   * @return  false when not connected, MAX_PENDING requests are waiting or
+   *          the message does not fit, callback is not called then
+   */
+  bool request(const char *event, const char *payload,
+               unsigned long timeoutInMs,
+               SPS_AsyncHTTP::ResponseCallback callback, int tag);
+
+  /**
+   * close the connection, waiting requests fail with CLOSED_ERROR
+   */
+  void stop();
+
+  /**
+   * @return  number of requests waiting for their answer
+   */
+  uint8_t getPending();
+
+private:
+  struct Pending {
+    bool used;
+    uint32_t id;
+    unsigned long requestTime; // millis
+    unsigned long timeout;
+    unsigned long sendTime;   // µs
+    unsigned long phaseStart; // micros
+    SPS_AsyncHTTP::ResponseCallback callback;
+    int tag;
+  };
+
+  const char *host;
+  uint16_t port;
+  const char *token;
+  SocketIOclient socketIO;
+  bool joining; // bridge:join sent, waiting for its acknowledgement
+  bool joined;
+  uint32_t joinId;
+  unsigned long rejectedAt; // millis, 0 unless the token was refused
+  uint32_t nextId;
+  Pending pending[MAX_PENDING];
+  char message[MESSAGE_SIZE];
+  PushCallback pushCallback;
+
+  void onEvent(socketIOmessageType_t type, uint8_t *payload, size_t length);
+  void onAck(char *payload);
+  void onJoinAck(const char *body);
+  void reject();
+  void onPush(const char *payload, size_t length);
+  void finish(Pending &request, int code, const char *body);
+  void failAll(int code);
+};
+
+#endif
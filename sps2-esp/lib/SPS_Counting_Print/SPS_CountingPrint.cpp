@@ -0,0 +1,23 @@
+#include "SPS_CountingPrint.h"
+
+SPS_CountingPrint::SPS_CountingPrint(Print *output)
+    : output(output), bytes(0) {}
+
+size_t SPS_CountingPrint::write(uint8_t c) { return write(&c, 1); }
+
+size_t SPS_CountingPrint::write(const uint8_t *buffer, size_t size) {
+  bytes += size;
+  if (output != NULL) {
+    output->write(buffer, size);
+  }
+  // dropped bytes count as written, the caller must not retry them
+  return size;
+}
+
+void SPS_CountingPrint::flush() {
+  if (output != NULL) {
+    output->flush();
+  }
+}
+
+unsigned long SPS_CountingPrint::getBytes() { return bytes; }
@@ -0,0 +1,31 @@
+#ifndef SPS_CountingPrint_H
+#define SPS_CountingPrint_H
+
+#include <Arduino.h>
+
+/**
+ * Print that counts the bytes written through it and passes them on to
+ * another Print, or drops them when there is none
+ */
+class SPS_CountingPrint : public Print {
+public:
+  /**
+   * @param   output      where the bytes go, NULL to drop them
+   */
+  SPS_CountingPrint(Print *output);
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  void flush() override;
+
+  /**
+   * @return  bytes written since boot
+   */
+  unsigned long getBytes();
+
+private:
+  Print *output;
+  unsigned long bytes;
+};
+
+#endif
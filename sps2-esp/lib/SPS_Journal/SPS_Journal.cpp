@@ -0,0 +1,280 @@
+#include "SPS_Journal.h"
+#include <LittleFS.h>
+
+#define JOURNAL_DIRECTORY "/journal"
+#define JOURNAL_STATE_PATH JOURNAL_DIRECTORY "/state"
+
+SPS_Journal::SPS_Journal()
+    : mounted(false), segmentCount(0), nextSeq(1), ackedSeq(0), boot(0),
+      dropped(0) {}
+
+bool SPS_Journal::begin() {
+  if (!LittleFS.begin()) {
+    if (!LittleFS.format() || !LittleFS.begin()) {
+      return false;
+    }
+  }
+  LittleFS.mkdir(JOURNAL_DIRECTORY);
+  mounted = true;
+
+  loadState();
+  scanSegments();
+  recoverTail();
+
+  // sequence numbers continue after the last acknowledged one even when all
+  // files are gone
+  if (nextSeq <= ackedSeq) {
+    nextSeq = ackedSeq + 1;
+  }
+  removeAcknowledgedSegments();
+
+  boot++;
+  saveState();
+  return true;
+}
+
+bool SPS_Journal::append(uint8_t type, uint8_t value, const uint8_t *data) {
+  if (!mounted) {
+    return false;
+  }
+
+  if (segmentCount == 0 ||
+      nextSeq - segments[segmentCount - 1] >= SEGMENT_RECORDS) {
+    if (segmentCount == SEGMENT_COUNT) {
+      dropOldestSegment();
+    }
+    segments[segmentCount++] = nextSeq;
+  }
+
+  uint8_t buffer[RECORD_SIZE];
+  Record &record = *(Record *)buffer;
+  record.seq = nextSeq;
+  record.uptime = millis();
+  record.boot = boot;
+  record.type = type;
+  record.value = value;
+  if (data != NULL) {
+    memcpy(record.data, data, DATA_SIZE);
+  } else {
+    memset(record.data, 0, DATA_SIZE);
+  }
+  uint16_t crc = crc16(buffer, sizeof(Record));
+  memcpy(buffer + sizeof(Record), &crc, sizeof(crc));
+
+  File file = LittleFS.open(pathOf(segments[segmentCount - 1]), "a");
+  if (!file) {
+    return false;
+  }
+  size_t size = file.size();
+  if (file.write(buffer, RECORD_SIZE) != RECORD_SIZE) {
+    // a torn record would shift every record after it
+    file.truncate(size);
+    file.close();
+    return false;
+  }
+  file.close();
+
+  nextSeq++;
+  return true;
+}
+
+uint8_t SPS_Journal::peek(Record *records, uint8_t max, uint32_t &throughSeq) {
+  uint8_t count = 0;
+  uint32_t seq = ackedSeq + 1;
+  throughSeq = ackedSeq;
+
+  for (uint8_t i = 0; i < segmentCount && count < max; i++) {
+    uint32_t lastSeq = lastSeqOf(i);
+    if (lastSeq < seq) {
+      continue;
+    }
+    if (seq < segments[i]) {
+      seq = segments[i];
+    }
+
+    File file = LittleFS.open(pathOf(segments[i]), "r");
+    if (!file || !file.seek((seq - segments[i]) * RECORD_SIZE, SeekSet)) {
+      // unreadable file, skip past it
+      throughSeq = lastSeq;
+      seq = lastSeq + 1;
+      continue;
+    }
+
+    uint8_t buffer[RECORD_SIZE];
+    while (count < max && seq <= lastSeq) {
+      if (file.read(buffer, RECORD_SIZE) != RECORD_SIZE) {
+        seq = lastSeq + 1;
+        break;
+      }
+      uint16_t crc;
+      memcpy(&crc, buffer + sizeof(Record), sizeof(crc));
+      if (crc == crc16(buffer, sizeof(Record))) {
+        memcpy(&records[count++], buffer, sizeof(Record));
+      }
+      seq++;
+    }
+    throughSeq = seq - 1;
+    file.close();
+  }
+
+  return count;
+}
+
+void SPS_Journal::acknowledge(uint32_t seq) {
+  if (seq <= ackedSeq || seq >= nextSeq) {
+    return;
+  }
+  ackedSeq = seq;
+  removeAcknowledgedSegments();
+  saveState();
+}
+
+uint32_t SPS_Journal::getPending() { return nextSeq - 1 - ackedSeq; }
+
+uint32_t SPS_Journal::getDropped() { return dropped; }
+
+uint16_t SPS_Journal::getBoot() { return boot; }
+
+void SPS_Journal::loadState() {
+  State state;
+  File file = LittleFS.open(JOURNAL_STATE_PATH, "r");
+  if (file && file.read((uint8_t *)&state, sizeof(state)) == sizeof(state) &&
+      state.crc == crc16((uint8_t *)&state, sizeof(state) - sizeof(state.crc))) {
+    ackedSeq = state.ackedSeq;
+    boot = state.boot;
+  }
+  // without a valid state everything still on flash is uploaded again
+  if (file) {
+    file.close();
+  }
+}
+
+void SPS_Journal::saveState() {
+  State state;
+  state.ackedSeq = ackedSeq;
+  state.boot = boot;
+  state.crc = crc16((uint8_t *)&state, sizeof(state) - sizeof(state.crc));
+
+  File file = LittleFS.open(JOURNAL_STATE_PATH, "w");
+  if (file) {
+    file.write((uint8_t *)&state, sizeof(state));
+    file.close();
+  }
+}
+
+void SPS_Journal::scanSegments() {
+  segmentCount = 0;
+
+  Dir dir = LittleFS.openDir(JOURNAL_DIRECTORY);
+  while (dir.next()) {
+    String name = dir.fileName();
+    char *end;
+    uint32_t firstSeq = strtoul(name.c_str(), &end, 16);
+    if (name.length() != 8 || *end != '\0' || firstSeq == 0) {
+      continue; // the state file
+    }
+
+    // insertion sort, the oldest segment goes out if there are too many
+    uint8_t i = segmentCount;
+    if (segmentCount == SEGMENT_COUNT) {
+      if (firstSeq < segments[0]) {
+        LittleFS.remove(pathOf(firstSeq));
+        continue;
+      }
+      LittleFS.remove(pathOf(segments[0]));
+      memmove(segments, segments + 1, (SEGMENT_COUNT - 1) * sizeof(uint32_t));
+      i = --segmentCount;
+    }
+    while (i > 0 && segments[i - 1] > firstSeq) {
+      segments[i] = segments[i - 1];
+      i--;
+    }
+    segments[i] = firstSeq;
+    segmentCount++;
+  }
+}
+
+void SPS_Journal::recoverTail() {
+  if (segmentCount == 0) {
+    return;
+  }
+
+  // a power loss can leave a partial or damaged last record
+  uint32_t firstSeq = segments[segmentCount - 1];
+  File file = LittleFS.open(pathOf(firstSeq), "r+");
+  if (!file) {
+    nextSeq = firstSeq;
+    return;
+  }
+
+  uint32_t count = file.size() / RECORD_SIZE;
+  if (count > SEGMENT_RECORDS) {
+    count = SEGMENT_RECORDS;
+  }
+  while (count > 0) {
+    uint8_t buffer[RECORD_SIZE];
+    uint16_t crc = 0;
+    file.seek((count - 1) * RECORD_SIZE, SeekSet);
+    if (file.read(buffer, RECORD_SIZE) == RECORD_SIZE) {
+      memcpy(&crc, buffer + sizeof(Record), sizeof(crc));
+      if (crc == crc16(buffer, sizeof(Record))) {
+        break;
+      }
+    }
+    count--;
+  }
+  if (file.size() != count * RECORD_SIZE) {
+    file.truncate(count * RECORD_SIZE);
+  }
+  file.close();
+
+  nextSeq = firstSeq + count;
+}
+
+void SPS_Journal::dropOldestSegment() {
+  uint32_t lastSeq = lastSeqOf(0);
+  if (lastSeq > ackedSeq) {
+    uint32_t firstUnacked = ackedSeq >= segments[0] ? ackedSeq + 1 : segments[0];
+    dropped += lastSeq - firstUnacked + 1;
+    ackedSeq = lastSeq;
+  }
+
+  LittleFS.remove(pathOf(segments[0]));
+  memmove(segments, segments + 1, (segmentCount - 1) * sizeof(uint32_t));
+  segmentCount--;
+  saveState();
+}
+
+void SPS_Journal::removeAcknowledgedSegments() {
+  while (segmentCount > 0 && lastSeqOf(0) <= ackedSeq) {
+    LittleFS.remove(pathOf(segments[0]));
+    memmove(segments, segments + 1, (segmentCount - 1) * sizeof(uint32_t));
+    segmentCount--;
+  }
+}
+
+uint32_t SPS_Journal::lastSeqOf(uint8_t segment) {
+  if (segment + 1 < segmentCount) {
+    return segments[segment + 1] - 1;
+  }
+  return nextSeq - 1;
+}
+
+String SPS_Journal::pathOf(uint32_t firstSeq) {
+  char path[24];
+  snprintf(path, sizeof(path), JOURNAL_DIRECTORY "/%08lx",
+           (unsigned long)firstSeq);
+  return String(path);
+}
+
+// CRC-16/CCITT-FALSE
+uint16_t SPS_Journal::crc16(const uint8_t *data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
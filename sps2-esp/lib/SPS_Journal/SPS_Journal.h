@@ -0,0 +1,112 @@
+#ifndef SPS_Journal_H
+#define SPS_Journal_H
+
+#include <Arduino.h>
+
+/**
+ * Append-only event journal in LittleFS that survives power loss. Records get
+ * a sequence number that never repeats, even across reboots, and are kept
+ * until acknowledge() says the server has them.
+ *
+ * The journal is a ring of SEGMENT_COUNT files of SEGMENT_RECORDS records,
+ * each named after its first sequence number. Appends only ever go to the
+ * newest file and fully acknowledged files are deleted, so writes move
+ * across the flash instead of rewriting one place. When the ring is full the
+ * oldest file is dropped.
+ *
+ * Sizing: 16 * 256 records of 18 bytes is 72 KB of flash. At one slot change
+ * a minute plus one card read every five minutes offline that holds about
+ * two days
+ */
+class SPS_Journal {
+public:
+  enum {
+    SEGMENT_COUNT = 16,
+    SEGMENT_RECORDS = 256,
+    DATA_SIZE = 4
+  };
+
+  struct Record {
+    uint32_t seq;
+    uint32_t uptime; // millis() when appended
+    uint16_t boot;   // boot counter, uptime restarts with every boot
+    uint8_t type;
+    uint8_t value;
+    uint8_t data[DATA_SIZE];
+  } __attribute__((packed));
+
+  SPS_Journal();
+
+  /**
+   * mount LittleFS, formatting it if it can not be mounted, recover the
+   * journal and count this boot. Must be used before other functions
+   * @return  false when the file system is not usable, appends fail then
+   */
+  bool begin();
+
+  /**
+   * @param   type        what the record means, up to the caller
+   * @param   value       one byte of payload
+   * @param   data        DATA_SIZE bytes of payload or NULL for zeros
+   * @return  false when the record could not be written
+   */
+  bool append(uint8_t type, uint8_t value, const uint8_t *data);
+
+  /**
+   * read the oldest records not acknowledged yet, damaged ones are skipped
+   * @param   records     receives up to max records in sequence order
+   * @param   max         size of records
+   * @param   throughSeq  sequence number of the last record looked at, the
+   *                      one to acknowledge once the records are uploaded
+   * @return  number of records read
+   */
+  uint8_t peek(Record *records, uint8_t max, uint32_t &throughSeq);
+
+  /**
+   * every record up to and including seq has been uploaded, their files may
+   * be deleted
+   */
+  void acknowledge(uint32_t seq);
+
+  /**
+   * @return  records appended and not yet acknowledged
+   */
+  uint32_t getPending();
+
+  /**
+   * @return  records lost to a full ring since boot
+   */
+  uint32_t getDropped();
+
+  uint16_t getBoot();
+
+private:
+  struct State {
+    uint32_t ackedSeq;
+    uint16_t boot;
+    uint16_t crc;
+  } __attribute__((packed));
+
+  enum { RECORD_SIZE = sizeof(Record) + sizeof(uint16_t) };
+
+  bool mounted;
+  uint32_t segments[SEGMENT_COUNT]; // first sequence number, oldest first
+  uint8_t segmentCount;
+  uint32_t nextSeq;
+  uint32_t ackedSeq;
+  uint16_t boot;
+  uint32_t dropped;
+
+  void loadState();
+  void saveState();
+  void scanSegments();
+  void recoverTail();
+  void dropOldestSegment();
+  void removeAcknowledgedSegments();
+  uint32_t lastSeqOf(uint8_t segment);
+  String pathOf(uint32_t firstSeq);
+
+  static uint16_t crc16(const uint8_t *data, size_t length);
+};
+
+#endif
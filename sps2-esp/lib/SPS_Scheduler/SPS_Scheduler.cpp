@@ -0,0 +1,62 @@
+#include "SPS_Scheduler.h"
+
+SPS_Scheduler::SPS_Scheduler() : taskCount(0) {}
+
+bool SPS_Scheduler::add(const char *name, Task task) {
+  if (taskCount == MAX_TASKS) {
+    return false;
+  }
+
+  Entry &entry = tasks[taskCount++];
+  entry.name = name;
+  entry.task = task;
+  entry.due = micros();
+  entry.runs = 0;
+  entry.totalTime = 0;
+  entry.maxTime = 0;
+  entry.maxLate = 0;
+  return true;
+}
+
+void SPS_Scheduler::run() {
+  for (uint8_t i = 0; i < taskCount; i++) {
+    Entry &entry = tasks[i];
+    unsigned long start = micros();
+    // signed difference, micros() wraps every 71 minutes
+    long late = (long)(start - entry.due);
+    if (late < 0) {
+      continue;
+    }
+
+    unsigned long interval = entry.task();
+    unsigned long end = micros();
+
+    entry.runs++;
+    entry.totalTime += end - start;
+    if (end - start > entry.maxTime) {
+      entry.maxTime = end - start;
+    }
+    if ((unsigned long)late > entry.maxLate) {
+      entry.maxLate = late;
+    }
+    // a task asking for 0 is due now and its lateness is the time between
+    // two passes
+    entry.due = end + interval * 1000;
+  }
+  yield();
+}
+
+void SPS_Scheduler::printStats(Print &out) {
+  for (uint8_t i = 0; i < taskCount; i++) {
+    Entry &entry = tasks[i];
+    out.printf("[SCHED] %-8s runs: %lu avg: %lu us max: %lu us late: %lu us\n",
+               entry.name, entry.runs,
+               entry.runs > 0 ? entry.totalTime / entry.runs : 0,
+               entry.maxTime, entry.maxLate);
+
+    entry.runs = 0;
+    entry.totalTime = 0;
+    entry.maxTime = 0;
+    entry.maxLate = 0;
+  }
+}
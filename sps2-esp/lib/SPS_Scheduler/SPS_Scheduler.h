@@ -0,0 +1,60 @@
+#ifndef SPS_Scheduler_H
+#define SPS_Scheduler_H
+
+#include <Arduino.h>
+
+/**
+ * Cooperative scheduler for loop(). A task is a function that does a short
+ * piece of work without blocking and returns how long until it wants to run
+ * again. Nothing preempts a task, so the longest task run bounds how late
+ * any other task starts.
+ *
+ * Every task keeps its number of runs, its longest and average run time and
+ * how late it started at worst, printStats() shows them
+ */
+class SPS_Scheduler {
+public:
+  enum { MAX_TASKS = 8 };
+
+  /**
+   * @return  ms until the task runs again, 0 to run it on every pass
+   */
+  typedef unsigned long (*Task)();
+
+  SPS_Scheduler();
+
+  /**
+   * @param   name        shown by printStats, the string must outlive the
+   *                      scheduler
+   * @param   task        runs on the next pass, then as it asks
+   * @return  false when MAX_TASKS tasks are already added
+   */
+  bool add(const char *name, Task task);
+
+  /**
+   * one pass: run every task that is due once, in the order they were added.
+   * Call it from loop()
+   */
+  void run();
+
+  /**
+   * print one line per task and start the next measuring window
+   */
+  void printStats(Print &out);
+
+private:
+  struct Entry {
+    const char *name;
+    Task task;
+    unsigned long due; // micros
+    unsigned long runs;
+    unsigned long totalTime; // µs
+    unsigned long maxTime;   // µs
+    unsigned long maxLate;   // µs from due to start
+  };
+
+  Entry tasks[MAX_TASKS];
+  uint8_t taskCount;
+};
+
+#endif
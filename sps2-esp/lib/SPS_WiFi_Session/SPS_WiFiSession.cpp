@@ -0,0 +1,142 @@
+#include "SPS_WiFiSession.h"
+
+// first 4-byte block of the RTC user memory
+#define SESSION_RTC_OFFSET 0
+
+SPS_WiFiSession::SPS_WiFiSession(const char *ssid, const char *password)
+    : ssid(ssid), password(password), useStaticIP(false), sessionValid(false),
+      connected(false), fastConnect(false), connectStart(0), connectTime(0) {}
+
+void SPS_WiFiSession::setStaticIP(IPAddress ip, IPAddress gateway,
+                                  IPAddress subnet, IPAddress dns) {
+  staticIP = ip;
+  staticGateway = gateway;
+  staticSubnet = subnet;
+  staticDns = dns;
+  useStaticIP = true;
+}
+
+void SPS_WiFiSession::begin() {
+  // every begin() would otherwise rewrite the SDK's settings in flash
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+
+  loadSession();
+  connect(true);
+}
+
+bool SPS_WiFiSession::update() {
+  if (WiFi.status() == WL_CONNECTED) {
+    if (!connected) {
+      connected = true;
+      connectTime = millis() - connectStart;
+      saveSession();
+    }
+    return true;
+  }
+
+  if (connected) {
+    // the SDK reconnects on its own, give it the full timeout
+    connected = false;
+    fastConnect = false;
+    connectStart = millis();
+  }
+
+  unsigned long timeout = fastConnect ? FAST_CONNECT_TIMEOUT_MS : CONNECT_TIMEOUT_MS;
+  if (millis() - connectStart >= timeout) {
+    if (fastConnect) {
+      // the access point moved, went away or the address is taken
+      forgetSession();
+    }
+    connect(true);
+  }
+  return false;
+}
+
+void SPS_WiFiSession::reconnect() {
+  WiFi.disconnect();
+  connected = false;
+  if (sessionValid) {
+    session.ip = 0;
+    writeSession();
+  }
+  connect(true);
+}
+
+bool SPS_WiFiSession::isFastConnect() { return fastConnect; }
+
+unsigned long SPS_WiFiSession::getConnectTime() { return connectTime; }
+
+void SPS_WiFiSession::connect(bool fast) {
+  fastConnect = fast && sessionValid;
+
+  if (useStaticIP) {
+    WiFi.config(staticIP, staticGateway, staticSubnet, staticDns);
+  } else if (fastConnect && session.ip != 0) {
+    WiFi.config(IPAddress(session.ip), IPAddress(session.gateway),
+                IPAddress(session.subnet), IPAddress(session.dns));
+  } else {
+    // all zero switches DHCP back on
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+  }
+
+  if (fastConnect) {
+    WiFi.begin(ssid, password, session.channel, session.bssid);
+  } else {
+    WiFi.begin(ssid, password);
+  }
+  connectStart = millis();
+}
+
+void SPS_WiFiSession::loadSession() {
+  sessionValid =
+      ESP.rtcUserMemoryRead(SESSION_RTC_OFFSET, (uint32_t *)&session, sizeof(session)) &&
+      session.crc == crc32((const uint8_t *)&session + sizeof(session.crc),
+                           sizeof(session) - sizeof(session.crc));
+}
+
+void SPS_WiFiSession::saveSession() {
+  Session current;
+  memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+  current.channel = WiFi.channel();
+  current.reserved = 0;
+  // a static address is configured anyway, the lease is only worth keeping
+  // when it came from DHCP
+  current.ip = useStaticIP ? 0 : (uint32_t)WiFi.localIP();
+  current.gateway = WiFi.gatewayIP();
+  current.subnet = WiFi.subnetMask();
+  current.dns = WiFi.dnsIP();
+  current.crc = crc32((const uint8_t *)&current + sizeof(current.crc),
+                      sizeof(current) - sizeof(current.crc));
+
+  if (sessionValid && memcmp(&current, &session, sizeof(session)) == 0) {
+    return;
+  }
+  session = current;
+  writeSession();
+}
+
+void SPS_WiFiSession::writeSession() {
+  session.crc = crc32((const uint8_t *)&session + sizeof(session.crc),
+                      sizeof(session) - sizeof(session.crc));
+  sessionValid = ESP.rtcUserMemoryWrite(SESSION_RTC_OFFSET, (uint32_t *)&session, sizeof(session));
+}
+
+void SPS_WiFiSession::forgetSession() {
+  sessionValid = false;
+  memset(&session, 0, sizeof(session));
+  ESP.rtcUserMemoryWrite(SESSION_RTC_OFFSET, (uint32_t *)&session, sizeof(session));
+}
+
+// CRC-32 (IEEE), RTC memory holds garbage after a power loss
+uint32_t SPS_WiFiSession::crc32(const uint8_t *data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+  }
+  return ~crc;
+}
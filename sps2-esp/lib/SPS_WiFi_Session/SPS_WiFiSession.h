@@ -0,0 +1,102 @@
+#ifndef SPS_WiFiSession_H
+#define SPS_WiFiSession_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+/**
+ * Station connection that remembers the access point it last joined. The
+ * BSSID, channel and IP configuration are kept in RTC memory, which survives
+ * a reset but not a power loss, so the next connect goes straight to that
+ * access point without a scan and reuses the address without asking DHCP.
+ * When that does not work within FAST_CONNECT_TIMEOUT_MS the session is
+ * forgotten and a normal connect with scan and DHCP follows.
+ *
+ * A static address set with setStaticIP() is used on every connect instead.
+ *
+ * Nothing blocks, update() follows the SDK connecting in the background
+ */
+class SPS_WiFiSession {
+public:
+  enum {
+    FAST_CONNECT_TIMEOUT_MS = 3000,
+    CONNECT_TIMEOUT_MS = 10000
+  };
+
+  /**
+   * @param   ssid        network name, the string must outlive the session
+   * @param   password    its password, the same
+   */
+  SPS_WiFiSession(const char *ssid, const char *password);
+
+  /**
+   * use a fixed address instead of DHCP, call before begin()
+   */
+  void setStaticIP(IPAddress ip, IPAddress gateway, IPAddress subnet,
+                   IPAddress dns);
+
+  /**
+   * switch to station mode without writing flash and start connecting, with
+   * the session from RTC memory when there is a valid one
+   */
+  void begin();
+
+  /**
+   * follow the connection and retry or fall back when it takes too long,
+   * call it periodically
+   * @return  true while connected
+   */
+  bool update();
+
+  /**
+   * drop the connection and connect again to the same access point. The
+   * address is asked from DHCP again since a stale one may be the problem
+   */
+  void reconnect();
+
+  /**
+   * @return  true when the last connect used the session from RTC memory
+   */
+  bool isFastConnect();
+
+  /**
+   * @return  ms from the start of the last connect to being connected
+   */
+  unsigned long getConnectTime();
+
+private:
+  struct Session {
+    uint32_t crc;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ip; // 0 when the address is not known
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+  };
+
+  const char *ssid;
+  const char *password;
+  IPAddress staticIP;
+  IPAddress staticGateway;
+  IPAddress staticSubnet;
+  IPAddress staticDns;
+  bool useStaticIP;
+  Session session;
+  bool sessionValid;
+  bool connected;
+  bool fastConnect;
+  unsigned long connectStart;
+  unsigned long connectTime;
+
+  void connect(bool fast);
+  void loadSession();
+  void saveSession();
+  void writeSession();
+  void forgetSession();
+
+  static uint32_t crc32(const uint8_t *data, size_t length);
+};
+
+#endif
@@ -1,204 +1,1017 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266WiFiMulti.h>
 #include <ESP8266HTTPClient.h>
-#include <WiFiClient.h>
+#include <SPS_AsyncHTTP.h>
+#include <SPS_BridgeChannel.h>
+#include <SPS_Journal.h>
+#include <SPS_Scheduler.h>
+#include <SPS_CountingPrint.h>
+#include <SPS_WiFiSession.h>
 #include <ArduinoJson.h>
 
 #define ENTRY_INVALID_CARD 0
 #define ENTRY_VALID_CARD 1
 #define EXIT_INVALID_CARD 3
 #define EXIT_VALID_CARD 4
-#define REQUEST_FAIL 5
+#define ENTRY_REQUEST_FAIL 7 // the check did not reach the server, keyed by gate like the other results
+#define EXIT_REQUEST_FAIL 8
+
+#define FULL_STATE 0
+#define CHANGED_STATE 1
+
+#define OPERATOR_NAME "Operator" // shown on the LCD for a gate opened from the web
+
+// where diagnostics go. The Mega parses every line on UART0, so by default they leave on UART1, TX only on GPIO2.
+// LOG_UART0 mixes them into the Mega link as before, LOG_NONE does not even format them
+#define LOG_NONE 0
+#define LOG_UART1 1
+#define LOG_UART0 2
+#define LOG_OUTPUT LOG_UART1
+#define LOG_BAUD 115200
+
+#if LOG_OUTPUT == LOG_NONE
+#define LOG_PRINTF(...) do { if (0) logOutput.printf(__VA_ARGS__); } while (0)
+#define LOG_PRINTLN(...) do { if (0) logOutput.println(__VA_ARGS__); } while (0)
+#else
+#define LOG_PRINTF(...) logOutput.printf(__VA_ARGS__)
+#define LOG_PRINTLN(...) logOutput.println(__VA_ARGS__)
+#endif
+
+#define SERIAL_LINE_LENGTH 64
+#define CARD_ID_SIZE 24 // "0X6D-0XE2-0XD7-0X21"
+#define STATE_SIZE 24   // "n,n,n,n,n,n", up to 8 slots
+#define CARD_BATCH_WINDOW_MS 5 // checks arriving this soon after the first one go in the same request
+#define CARD_BATCH_SIZE 4
+#define CARD_BATCHES 4
+#define REQUEST_PATH_SIZE 96
+#define REQUEST_BODY_SIZE 384 // the requests copy it, one buffer serves all of them
+#define STATE_COALESCE_MS 500
+#define STATE_RETRY_MS 5000 // wait after a server error before the state is sent again
+#define PING_INTERVAL_MS 1000
+#define PING_MAX_INTERVAL_MS 30000 // a failed ping doubles the wait up to this
+#define WIFI_CHECK_MS 500
+#define DISPATCH_INTERVAL_MS 20
+#define LOG_INTERVAL_MS 30000
+
+// journal record types, card events use the gate position 'R' or 'L'
+#define JOURNAL_STATE 'S'
+#define JOURNAL_BATCH_RECORDS 8
+#define JOURNAL_BATCH_BYTES 360 // body of one upload, must fit REQUEST_BODY_SIZE and SPS_AsyncHTTP::REQUEST_SIZE with the headers
+#define JOURNAL_RETRY_MS 5000
+
+// fire POOL_SIZE card checks at once every HTTP_BENCHMARK_INTERVAL_MS and print the time they take together
+// against the time they would take one after the other. Start the server with RESPONSE_DELAY to simulate a slow one
+// #define HTTP_BENCHMARK
+#define HTTP_BENCHMARK_INTERVAL_MS 10000
+
+// feed CARD_BURST_SIZE made up CARD lines at once every CARD_BURST_INTERVAL_MS and print how fast they are all
+// answered. Run it against sps2-esp/tools/stand_in_server.py, every burst uses new cards
+// #define CARD_BURST_BENCHMARK
+#define CARD_BURST_SIZE 8
+#define CARD_BURST_INTERVAL_MS 10000
+
+// print the time spent building request bodies and parsing answers and the lowest free heap seen
+// #define JSON_BENCHMARK
 
 //NOTICE: change to the domain of webserver
 //NOTICE: currently, we cannot make ESP communicate with outsider server which is not in the same local wifi address with ESP
-const String WEB_SERVER_DOMAIN = "http://192.168.43.116:4000";
+const char *WEB_SERVER_HOST = "192.168.43.116";
+const uint16_t WEB_SERVER_PORT = 4000;
 const int MAX_FAILED_PING = 3;
+// BRIDGE_TOKEN of the web server, it only takes requests from and sends pushes to a bridge that has it.
+// It is not committed: secrets.ini passes it as a build flag, copy it from secrets.ini.example. At most 64 characters
+#ifndef BRIDGE_TOKEN
+#error "BRIDGE_TOKEN is not defined, copy secrets.ini.example to secrets.ini and set the web server's token"
+#endif
+
+// must use the same wifi as Webserver
+// const char *WIFI_SSID = "Trung Tam TT-TV";
+const char *WIFI_SSID = "AndroidAP";
+const char *WIFI_PASSWORD = "12345679";
+
+// fixed address for the bridge, no DHCP on any connect. Leave undefined to use DHCP, the lease is still reused after a reset
+// #define WIFI_STATIC_IP 192, 168, 43, 50
+#define WIFI_STATIC_GATEWAY 192, 168, 43, 1
+#define WIFI_STATIC_SUBNET 255, 255, 255, 0
+#define WIFI_STATIC_DNS 192, 168, 43, 1
+
+// the Mega protocol on UART0 and the diagnostics, both counted to show what the link is spared
+SPS_CountingPrint megaLink(&Serial);
+#if LOG_OUTPUT == LOG_UART1
+SPS_CountingPrint logOutput(&Serial1);
+#elif LOG_OUTPUT == LOG_UART0
+SPS_CountingPrint logOutput(&Serial);
+#else
+SPS_CountingPrint logOutput(NULL);
+#endif
+unsigned long cardLines;
 
-ESP8266WiFiMulti WiFiMulti;
+// loop() only runs the scheduler, every task returns quickly so a serial line waits at most one pass
+SPS_Scheduler scheduler;
+// the access point and address of the last connect are kept in RTC memory, a reset reconnects without scan and DHCP
+SPS_WiFiSession wifi(WIFI_SSID, WIFI_PASSWORD);
+bool wifiReady;
 bool readyToRequest;
 int failedPingCounter;
-const String healthCheckUrl = WEB_SERVER_DOMAIN + "/healthcheck";
-const String carEnteringUrl = WEB_SERVER_DOMAIN + "/api/v1/cards/linked-vehicle";
-const String updateParkingSlotUrl = WEB_SERVER_DOMAIN + "/api/v1/parking-slots";
-WiFiClient client;
-HTTPClient http;
+bool pingInFlight;
+unsigned long pingInterval;
+const char *healthCheckUrl = "/healthcheck";
+const char *carEnteringUrl = "/api/v1/cards/linked-vehicle";
+const char *cardBatchUrl = "/api/v1/cards/linked-vehicle/batch";
+const char *updateParkingSlotUrl = "/api/v1/parking-slots";
+const char *journalUrl = "/api/v1/journal";
+
+// requests run in the background, serial keeps being read while they wait for the server.
+// They go over the channel while it is connected and over HTTP otherwise
+SPS_AsyncHTTP http(WEB_SERVER_HOST, WEB_SERVER_PORT, BRIDGE_TOKEN);
+SPS_BridgeChannel channel(WEB_SERVER_HOST, WEB_SERVER_PORT, BRIDGE_TOKEN);
+char serialLine[SERIAL_LINE_LENGTH];
+size_t serialLineLength;
+
+// request paths and bodies are written here instead of being concatenated in Strings. Card ids and states are kept
+// in fixed buffers too, the only allocations left per request are the JsonDocument pools that parse the answers
+char requestPath[REQUEST_PATH_SIZE];
+char requestBody[REQUEST_BODY_SIZE];
+// only the results of a card check answer are kept, the rest is skipped while parsing
+JsonDocument checkFilter;
+
+// card checks sent to the server in one request, each CARD line still gets its own answer. A card read again at
+// the same gate while its check waits is answered from the same result
+struct CardBatch {
+  bool used;
+  uint8_t count;          // CARD lines
+  uint8_t checkCount;     // distinct checks sent
+  char gatePos[CARD_BATCH_SIZE];
+  char cardIds[CARD_BATCH_SIZE][CARD_ID_SIZE];
+  uint8_t checkIndex[CARD_BATCH_SIZE]; // position of each line's check in the request and its answer
+};
+CardBatch cardBatches[CARD_BATCHES];
+int collectingBatch; // the batch new checks join, -1 when there is none
+unsigned long collectingSince;
+unsigned long cardLinesBatched;
+unsigned long cardRequestsSent;
+
+// parking states as "n,n,n,n,n,n". ackedState is empty while the server's copy is unknown
+char ackedState[STATE_SIZE];
+char sentState[STATE_SIZE];
+char pendingState[STATE_SIZE];
+unsigned long pendingSince;
+unsigned long stateFailedAt; // 0 unless the last update got a server error
+bool stateInFlight;
+unsigned long stateLinesReceived;
+unsigned long stateRequestsSent;
+unsigned long stateLinesCoalesced;
+unsigned long stateLinesUnchanged;
+
+// what could not reach the server waits in flash and is uploaded in order once it is back
+SPS_Journal journal;
+bool journalInFlight;
+uint32_t journalUploadSeq;
+unsigned long lastJournalUpload;
+unsigned long journalRecordsUploaded;
+
+bool channelWasConnected;
+bool channelWasRejected;
+
+// millis() of the first time after boot, 0 until then. millis() starts with the sketch, the boot loader is not counted
+unsigned long wifiReadyAt;
+unsigned long serverReadyAt;
+unsigned long firstCardAt;
+
+unsigned long jsonBuildTime; // µs of the last request body or path
+unsigned long jsonParseTime; // µs of the last card check answer
+#ifdef JSON_BENCHMARK
+uint32_t minFreeHeap;
+#endif
+
+#ifdef CARD_BURST_BENCHMARK
+unsigned long burstStartTime;
+uint8_t burstPending;
+uint16_t burstNumber;
+#endif
+
+#ifdef HTTP_BENCHMARK
+unsigned long benchmarkStartTime;
+unsigned long benchmarkSequentialTime;
+uint8_t benchmarkPending;
+#endif
+
+void onServerPush(const char *event, JsonVariantConst data);
+unsigned long serialTask();
+unsigned long networkTask();
+unsigned long wifiTask();
+unsigned long healthTask();
+unsigned long dispatchTask();
+#if LOG_OUTPUT != LOG_NONE
+unsigned long logTask();
+#endif
 
 void setup() {
   Serial.begin(9600);
+#if LOG_OUTPUT == LOG_UART1
+  Serial1.begin(LOG_BAUD);
+#endif
+  cardLines = 0;
   readyToRequest = false;
   failedPingCounter = 0;
+  pingInFlight = false;
+  pingInterval = PING_INTERVAL_MS;
+  wifiReady = false;
+  wifiReadyAt = 0;
+  serverReadyAt = 0;
+  firstCardAt = 0;
+  serialLineLength = 0;
+  stateInFlight = false;
+  stateFailedAt = 0;
+  stateLinesReceived = 0;
+  stateRequestsSent = 0;
+  stateLinesCoalesced = 0;
+  stateLinesUnchanged = 0;
+  journalInFlight = false;
+  lastJournalUpload = 0;
+  journalRecordsUploaded = 0;
+  channelWasConnected = false;
+  channelWasRejected = false;
+#ifdef CARD_BURST_BENCHMARK
+  burstStartTime = 0;
+  burstPending = 0;
+  burstNumber = 0;
+#endif
+  checkFilter["info"][0]["status"] = true;
+  checkFilter["info"][0]["info"] = true;
+  collectingBatch = -1;
+  cardLinesBatched = 0;
+  cardRequestsSent = 0;
+  for (uint8_t i = 0; i < CARD_BATCHES; i++) {
+    cardBatches[i].used = false;
+  }
+  jsonBuildTime = 0;
+  jsonParseTime = 0;
+#ifdef JSON_BENCHMARK
+  minFreeHeap = ESP.getFreeHeap();
+#endif
+
+  // connect first, the SDK does it in the background while the journal is mounted
+#ifdef WIFI_STATIC_IP
+  wifi.setStaticIP(IPAddress(WIFI_STATIC_IP), IPAddress(WIFI_STATIC_GATEWAY), IPAddress(WIFI_STATIC_SUBNET),
+                   IPAddress(WIFI_STATIC_DNS));
+#endif
+  wifi.begin();
 
-  for (uint8_t t = 4; t > 0; t--) {
-    Serial.printf("[SETUP] WAIT %d...\n", t);
-    Serial.flush();
-    delay(1000);
+  if (!journal.begin()) {
+    LOG_PRINTLN("[JOURNAL] LittleFS not usable, offline events are lost");
   }
+  LOG_PRINTF("[JOURNAL] boot: %u pending: %lu\n", journal.getBoot(), (unsigned long)journal.getPending());
 
-  WiFi.mode(WIFI_STA);
-  // must use the same wifi as Webserver
-  // WiFiMulti.addAP("Trung Tam TT-TV", "12345679");
-  WiFiMulti.addAP("AndroidAP", "12345679");
+  channel.begin(onServerPush);
+
+  scheduler.add("serial", serialTask);
+  scheduler.add("network", networkTask);
+  scheduler.add("wifi", wifiTask);
+  scheduler.add("health", healthTask);
+  scheduler.add("dispatch", dispatchTask);
+#if LOG_OUTPUT != LOG_NONE
+  // with nothing to print to it would only take scheduler time
+  scheduler.add("log", logTask);
+#endif
 }
 
-String encodeQueryParam(const String &str) {
-    String encoded = "";
-    for (int i = 0; i < str.length(); i++) {
-        char c = str[i];
-        if (isalnum(c)) {
-            encoded += c;
-        } else {
-            encoded += '%';
-            char buf[3];
-            sprintf(buf, "%02X", c);
-            encoded += buf;
-        }
+void printBootTiming() {
+  LOG_PRINTF("[BOOT] wifi: %lu ms (%s) server: %lu ms first card: %lu ms\n", wifiReadyAt,
+             wifi.isFastConnect() ? "cached" : "scan", serverReadyAt, firstCardAt);
+}
+
+void markServerReady() {
+  readyToRequest = true;
+  pingInterval = PING_INTERVAL_MS;
+  if (serverReadyAt == 0) {
+    serverReadyAt = millis();
+  }
+}
+
+void printTiming(const SPS_AsyncHTTP::Response &response) {
+  LOG_PRINTF("[HTTP] connect: %lu us send: %lu us wait: %lu us\n",
+                response.connectTime, response.sendTime, response.waitTime);
+}
+
+#ifdef JSON_BENCHMARK
+void printJsonCost() {
+  LOG_PRINTF("[JSON] build: %lu us parse: %lu us heap: %u min: %u\n", jsonBuildTime, jsonParseTime,
+                ESP.getFreeHeap(), minFreeHeap);
+}
+#endif
+
+// "0X6D-0XE2-0XD7-0X21" to its SPS_Journal::DATA_SIZE bytes
+bool parseCardUid(const char *cardId, uint8_t *uid) {
+  const char *cursor = cardId;
+  for (uint8_t i = 0; i < SPS_Journal::DATA_SIZE; i++) {
+    char *end;
+    unsigned long value = strtoul(cursor, &end, 16);
+    if (end == cursor || value > 0xFF || (i + 1 < SPS_Journal::DATA_SIZE && *end != '-')) {
+      return false;
     }
-    return encoded;
+    uid[i] = value;
+    cursor = end + 1;
+  }
+  return true;
 }
 
-void requestToCheckCard (String cardId, String pos) {
-  //test
-  // Serial.println("USER:Huy\nCHECKING-RESULT:1");
-  // return;
+int formatCardUid(const uint8_t *uid, char *cardId, size_t size) {
+  return snprintf(cardId, size, "0X%02X-0X%02X-0X%02X-0X%02X", uid[0], uid[1], uid[2], uid[3]);
+}
 
-  http.setTimeout(10000); //ms
-  String url = carEnteringUrl 
-              + "?card_id=" + encodeQueryParam(cardId) 
-              + "&gate_pos=" + encodeQueryParam(pos);
-  String checkingResult = "CHECKING-RESULT:";
+// "n,n,n,n,n,n" to one bit per slot, data[0] keeps the number of slots
+uint8_t encodeStates(const char *states, uint8_t *data) {
+  uint8_t bits = 0;
+  uint8_t count = 0;
+  size_t length = strlen(states);
+  for (size_t i = 0; i < length && count < 8; i += 2, count++) {
+    if (states[i] == '1') {
+      bits |= 1 << count;
+    }
+  }
+  data[0] = count;
+  return bits;
+}
 
-  if (!http.begin(client, url)) {
-    readyToRequest = false;
-    Serial.println(checkingResult + REQUEST_FAIL);
-    http.end();
+// back to "n,n,n,n,n,n", states needs 16 bytes
+int decodeStates(uint8_t bits, const uint8_t *data, char *states) {
+  int length = 0;
+  for (uint8_t i = 0; i < data[0] && i < 8; i++) {
+    if (i > 0) {
+      states[length++] = ',';
+    }
+    states[length++] = (bits & (1 << i)) ? '1' : '0';
+  }
+  states[length] = '\0';
+  return length;
+}
+
+bool journalState(const char *states) {
+  uint8_t data[SPS_Journal::DATA_SIZE] = {0};
+  uint8_t bits = encodeStates(states, data);
+  if (!journal.append(JOURNAL_STATE, bits, data)) {
+    return false;
+  }
+  LOG_PRINTF("[JOURNAL] state %s, pending: %lu\n", states, (unsigned long)journal.getPending());
+  return true;
+}
+
+// a card the server could not check or did not see, kept so the server knows who stood at the gate
+void journalCardEvent(const char *cardId, char gatePos, uint8_t result) {
+  uint8_t uid[SPS_Journal::DATA_SIZE];
+  if (!parseCardUid(cardId, uid) || !journal.append(gatePos, result, uid)) {
     return;
   }
+  LOG_PRINTF("[JOURNAL] card %s at %c, pending: %lu\n", cardId, gatePos,
+                (unsigned long)journal.getPending());
+}
 
-  Serial.println("[HTTP] GET: request to check card");
-  int httpCode = http.GET();
+// the Mega's answer to one CARD line, code is the server's status for the card or an SPS_AsyncHTTP::Error.
+// A server error is no verdict on the card, it fails like a request that never got through
+void answerCard(const char *cardId, char gatePos, int code, const char *info) {
+  int result;
+  bool failed = code <= 0 || code >= HTTP_CODE_INTERNAL_SERVER_ERROR;
+  if (code == HTTP_CODE_OK || code == HTTP_CODE_MOVED_PERMANENTLY) {
+    megaLink.print("USER:");
+    megaLink.println(info != NULL ? info : "");
+    result = gatePos == 'R' ? ENTRY_VALID_CARD : EXIT_VALID_CARD;
+  } else if (!failed) {
+    result = gatePos == 'R' ? ENTRY_INVALID_CARD : EXIT_INVALID_CARD;
+  } else {
+    result = gatePos == 'R' ? ENTRY_REQUEST_FAIL : EXIT_REQUEST_FAIL;
+  }
+  megaLink.print("CHECKING-RESULT:");
+  megaLink.println(result);
 
-  if (httpCode > 0) {
-    if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
-      String payload = http.getString();
-      StaticJsonDocument<200> doc;
-      DeserializationError error = deserializeJson(doc, payload);
+  if (failed) {
+    journalCardEvent(cardId, gatePos, result);
+  } else if (firstCardAt == 0) {
+    firstCardAt = millis();
+    printBootTiming();
+  }
 
-      if (error) {
-        Serial.println("JSON parse failed");
-        return;
-      }
+#ifdef CARD_BURST_BENCHMARK
+  if (burstPending > 0 && --burstPending == 0) {
+    unsigned long burstTime = millis() - burstStartTime;
+    LOG_PRINTF("[BURST] %d cards answered in %lu ms, %lu cards/s\n", CARD_BURST_SIZE, burstTime,
+                  burstTime > 0 ? CARD_BURST_SIZE * 1000UL / burstTime : 0);
+  }
+#endif
+}
 
-      String info = doc["info"].as<String>();
-      Serial.println("USER:" + info);
-      checkingResult += (pos == "R" ? ENTRY_VALID_CARD : EXIT_VALID_CARD);
-    } else {
-      checkingResult += (pos == "R" ? ENTRY_INVALID_CARD : EXIT_INVALID_CARD);
+// tag is the index of the batch, the answer is {"info":[{"status":200,"info":"<user>"},{"status":404},...]}
+void onCardBatchChecked(const SPS_AsyncHTTP::Response &response, int index) {
+  CardBatch &batch = cardBatches[index];
+  printTiming(response);
+
+  JsonDocument doc;
+  bool parsed = false;
+  if (response.code == HTTP_CODE_OK) {
+    unsigned long start = micros();
+    DeserializationError error = deserializeJson(doc, response.body, DeserializationOption::Filter(checkFilter));
+    jsonParseTime = micros() - start;
+#ifdef JSON_BENCHMARK
+    printJsonCost();
+#endif
+    parsed = !error;
+    if (error) {
+      LOG_PRINTLN("JSON parse failed");
     }
-    Serial.println(checkingResult);
+  } else if (response.code > 0) {
+    LOG_PRINTF("[HTTP] POST... code: %d\n", response.code);
   } else {
     readyToRequest = false;
-    Serial.printf("[HTTP] GET... failed, error: %s\n", http.errorToString(httpCode).c_str());
-    Serial.println(checkingResult + REQUEST_FAIL);
+    LOG_PRINTF("[HTTP] POST... failed, error: %s\n", SPS_AsyncHTTP::errorToString(response.code));
+  }
+
+  for (uint8_t i = 0; i < batch.count; i++) {
+    int code = SPS_AsyncHTTP::RESPONSE_ERROR;
+    const char *info = NULL;
+    if (parsed) {
+      JsonVariant result = doc["info"][batch.checkIndex[i]];
+      if (!result.isNull()) {
+        code = result["status"].as<int>();
+        info = result["info"].as<const char *>();
+      }
+    } else if (response.code <= 0) {
+      code = response.code;
+    }
+    answerCard(batch.cardIds[i], batch.gatePos[i], code, info);
+  }
+  batch.used = false;
+}
+
+// send the collecting batch in one request
+void sendCardBatch() {
+  CardBatch &batch = cardBatches[collectingBatch];
+  int index = collectingBatch;
+  collectingBatch = -1;
+
+  // {"checks":[{"cardId":"0X6D-..","gatePos":"R"},...]}
+  unsigned long start = micros();
+  size_t length = strlcpy(requestBody, "{\"checks\":[", sizeof(requestBody));
+  uint8_t sent = 0;
+  for (uint8_t i = 0; i < batch.count; i++) {
+    if (batch.checkIndex[i] != sent) {
+      continue; // same card and gate as an earlier line
+    }
+    length += snprintf(requestBody + length, sizeof(requestBody) - length, "%s{\"cardId\":\"%s\",\"gatePos\":\"%c\"}",
+                       sent > 0 ? "," : "", batch.cardIds[i], batch.gatePos[i]);
+    sent++;
+  }
+  strlcat(requestBody, "]}", sizeof(requestBody));
+  jsonBuildTime = micros() - start;
+
+  bool started = false;
+  if (channel.isConnected()) {
+    LOG_PRINTF("[IO] card:check-batch: %u cards\n", batch.checkCount);
+    started = channel.request("card:check-batch", requestBody, 10000, onCardBatchChecked, index);
+  }
+  if (!started) {
+    LOG_PRINTF("[HTTP] POST: cardBatchUrl %u cards\n", batch.checkCount);
+    started = http.request("POST", cardBatchUrl, requestBody, 10000, onCardBatchChecked, index);
+  }
+  if (!started) {
+    LOG_PRINTLN("[HTTP] POST... failed, error: no free connection");
+    SPS_AsyncHTTP::Response response = {SPS_AsyncHTTP::CONNECT_ERROR, "", 0, 0, 0};
+    onCardBatchChecked(response, index);
+    return;
   }
 
-  http.end();
+  cardLinesBatched += batch.count;
+  cardRequestsSent++;
+  LOG_PRINTF("[BATCH] lines: %lu requests: %lu\n", cardLinesBatched, cardRequestsSent);
 }
 
-void requestToUpdateParkingState (String value) {
+// send the collecting batch once it is full or CARD_BATCH_WINDOW_MS old
+void flushCardBatch() {
+  if (collectingBatch < 0) {
+    return;
+  }
+  CardBatch &batch = cardBatches[collectingBatch];
+  if (batch.count == CARD_BATCH_SIZE || millis() - collectingSince >= CARD_BATCH_WINDOW_MS) {
+    sendCardBatch();
+  }
+}
+
+void requestToCheckCard (const char *cardId, char gatePos) {
   //test
+  // Serial.println("USER:Huy\nCHECKING-RESULT:1");
   // return;
 
-  http.setTimeout(10000); //ms
-  if (http.begin(client, updateParkingSlotUrl)) {
-    http.addHeader("Content-Type", "application/json");
-    Serial.println("[HTTP] PUT: updateParkingSlotUrl");
-    String payload = "{\"states\":\"" + value +  "\"}";
-    int httpCode = http.PUT(payload);
-    
-    if (httpCode > 0) {
-      Serial.printf("[HTTP] PUT... code: %d\n", httpCode);
-    } else {
-      readyToRequest = false;
-      Serial.printf("[HTTP] PUT... failed, error: %s\n", http.errorToString(httpCode).c_str());
+  if (collectingBatch < 0) {
+    for (uint8_t i = 0; i < CARD_BATCHES; i++) {
+      if (!cardBatches[i].used) {
+        collectingBatch = i;
+        break;
+      }
     }
+    if (collectingBatch < 0) {
+      LOG_PRINTLN("[HTTP] POST... failed, error: every batch is waiting");
+      answerCard(cardId, gatePos, SPS_AsyncHTTP::CONNECT_ERROR, NULL);
+      return;
+    }
+    cardBatches[collectingBatch].used = true;
+    cardBatches[collectingBatch].count = 0;
+    cardBatches[collectingBatch].checkCount = 0;
+    collectingSince = millis();
+  }
+
+  CardBatch &batch = cardBatches[collectingBatch];
+  uint8_t line = batch.count++;
+  strlcpy(batch.cardIds[line], cardId, CARD_ID_SIZE);
+  batch.gatePos[line] = gatePos;
+  batch.checkIndex[line] = batch.checkCount;
+  for (uint8_t i = 0; i < line; i++) {
+    if (batch.gatePos[i] == gatePos && strcmp(batch.cardIds[i], cardId) == 0) {
+      batch.checkIndex[line] = batch.checkIndex[i];
+      break;
+    }
+  }
+  if (batch.checkIndex[line] == batch.checkCount) {
+    batch.checkCount++;
+  }
+
+  if (batch.count == CARD_BATCH_SIZE) {
+    sendCardBatch();
+  }
+}
 
-    http.end();
+void printStateCounters() {
+  LOG_PRINTF("[STATE] lines: %lu sent: %lu saved: %lu (coalesced: %lu unchanged: %lu)\n",
+                stateLinesReceived, stateRequestsSent, stateLinesReceived - stateRequestsSent,
+                stateLinesCoalesced, stateLinesUnchanged);
+}
+
+void onParkingStateUpdated(const SPS_AsyncHTTP::Response &response, int tag) {
+  stateInFlight = false;
+  printTiming(response);
+
+  stateFailedAt = 0;
+  if (response.code >= 200 && response.code < 300) {
+    LOG_PRINTF("[HTTP] %s... code: %d\n", tag == FULL_STATE ? "PUT" : "PATCH", response.code);
+    strlcpy(ackedState, sentState, STATE_SIZE);
+    printStateCounters();
+    return;
+  }
+
+  if (response.code > 0 && response.code < HTTP_CODE_INTERNAL_SERVER_ERROR) {
+    // the server will never take this update, sending it again would only repeat the rejection.
+    // Its copy is unknown now, the next state sends every slot
+    LOG_PRINTF("[HTTP] %s... code: %d, state %s dropped\n", tag == FULL_STATE ? "PUT" : "PATCH", response.code,
+               sentState);
+    ackedState[0] = '\0';
+    return;
+  }
+
+  if (response.code > 0) {
+    LOG_PRINTF("[HTTP] %s... code: %d\n", tag == FULL_STATE ? "PUT" : "PATCH", response.code);
+    stateFailedAt = millis();
   } else {
     readyToRequest = false;
-    Serial.println("[HTTP] Unable to connect");
+    LOG_PRINTF("[HTTP] %s... failed, error: %s\n", tag == FULL_STATE ? "PUT" : "PATCH",
+                  SPS_AsyncHTTP::errorToString(response.code));
+  }
+
+  // the server state is unknown now, send the whole list again unless a newer state is already waiting
+  ackedState[0] = '\0';
+  if (pendingState[0] == '\0') {
+    strlcpy(pendingState, sentState, STATE_SIZE);
+    pendingSince = millis();
   }
 }
 
-void pingToExpressServer () {
+// latest value wins: a state that arrives while another one waits replaces it
+void requestToUpdateParkingState (const char *value) {
   //test
-  // readyToRequest = true;
   // return;
 
-  http.setTimeout(2000); //ms
-  if (http.begin(client, healthCheckUrl)) {
-    Serial.println("[HTTP] GET: health check server");
-    int httpCode = http.GET();
+  stateLinesReceived++;
+  if (pendingState[0] != '\0') {
+    stateLinesCoalesced++;
+  } else {
+    pendingSince = millis();
+  }
+  strlcpy(pendingState, value, STATE_SIZE);
+}
+
+// send the pending state once it has been stable for STATE_COALESCE_MS, only one update is ever in flight
+void flushParkingState() {
+  if (pendingState[0] == '\0' || stateInFlight || millis() - pendingSince < STATE_COALESCE_MS ||
+      (stateFailedAt != 0 && millis() - stateFailedAt < STATE_RETRY_MS)) {
+    return;
+  }
+
+  if (strcmp(pendingState, ackedState) == 0) {
+    // flapped back to what the server already has
+    stateLinesUnchanged++;
+    pendingState[0] = '\0';
+    printStateCounters();
+    return;
+  }
 
-    if (httpCode > 0) {
-      Serial.printf("[HTTP] GET: healthcheck code: %d\n", httpCode);
-      readyToRequest = true;
+  if (!readyToRequest || journal.getPending() > 0) {
+    // offline, or older events are still being uploaded: queue behind them to keep the order.
+    // The server's copy is only known again after the upload, the next live update sends every slot
+    if (journalState(pendingState)) {
+      pendingState[0] = '\0';
+      ackedState[0] = '\0';
+    }
+    return;
+  }
 
-      if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
-        String payload = http.getString();
-        Serial.println(payload);
+  // "n,n,n,n,n,n": the state of slot i is at index 2 * (i - 1)
+  int tag;
+  unsigned long start = micros();
+  size_t length = strlen(pendingState);
+  if (strlen(ackedState) != length) {
+    tag = FULL_STATE;
+    snprintf(requestBody, sizeof(requestBody), "{\"states\":\"%s\"}", pendingState);
+  } else {
+    tag = CHANGED_STATE;
+    int bodyLength = snprintf(requestBody, sizeof(requestBody), "{\"changes\":\"");
+    const char *separator = "";
+    for (size_t i = 0; i < length; i += 2) {
+      if (pendingState[i] != ackedState[i]) {
+        bodyLength += snprintf(requestBody + bodyLength, sizeof(requestBody) - bodyLength, "%s%u:%c", separator,
+                               (unsigned)(i / 2 + 1), pendingState[i]);
+        separator = ",";
       }
+    }
+    snprintf(requestBody + bodyLength, sizeof(requestBody) - bodyLength, "\"}");
+  }
+  jsonBuildTime = micros() - start;
+
+  bool started = false;
+  if (channel.isConnected()) {
+    LOG_PRINTLN("[IO] parking-slot:change");
+    started = channel.request("parking-slot:change", requestBody, 10000, onParkingStateUpdated, tag);
+  }
+  if (!started) {
+    const char *method = tag == FULL_STATE ? "PUT" : "PATCH";
+    LOG_PRINTF("[HTTP] %s: updateParkingSlotUrl\n", method);
+    started = http.request(method, updateParkingSlotUrl, requestBody, 10000, onParkingStateUpdated, tag);
+  }
+
+  if (!started) {
+    // every connection is busy, the state stays pending for the next loop
+    return;
+  }
+  stateRequestsSent++;
+  stateInFlight = true;
+  strlcpy(sentState, pendingState, STATE_SIZE);
+  pendingState[0] = '\0';
+}
+
+// events the server pushes over the channel
+void onServerPush(const char *event, JsonVariantConst data) {
+  if (strcmp(event, "gate:command") == 0) {
+    const char *gatePos = data["gatePos"].as<const char *>();
+    const char *action = data["action"].as<const char *>();
+    if (gatePos == NULL || action == NULL || strcmp(action, "open") != 0) {
+      return;
+    }
+
+    // the Mega opens a gate for an accepted card, a command is a card accepted without reading one
+    megaLink.println("USER:" OPERATOR_NAME);
+    megaLink.print("CHECKING-RESULT:");
+    megaLink.println(gatePos[0] == 'R' ? ENTRY_VALID_CARD : EXIT_VALID_CARD);
+  }
+}
+
+void onJournalUploaded(const SPS_AsyncHTTP::Response &response, int tag) {
+  journalInFlight = false;
+  printTiming(response);
+
+  if (response.code >= 200 && response.code < 300) {
+    uint32_t before = journal.getPending();
+    journal.acknowledge(journalUploadSeq);
+    journalRecordsUploaded += before - journal.getPending();
+    lastJournalUpload = 0; // keep going while there is more
+    LOG_PRINTF("[JOURNAL] uploaded: %lu pending: %lu dropped: %lu\n", journalRecordsUploaded,
+                  (unsigned long)journal.getPending(), (unsigned long)journal.getDropped());
+    return;
+  }
+
+  if (response.code == HTTP_CODE_UNPROCESSABLE_ENTITY) {
+    // the server will never take this batch, it would block every record behind it
+    LOG_PRINTF("[JOURNAL] batch through %lu rejected, skipped\n", (unsigned long)journalUploadSeq);
+    journal.acknowledge(journalUploadSeq);
+    return;
+  }
+
+  if (response.code > 0) {
+    LOG_PRINTF("[JOURNAL] upload... code: %d\n", response.code);
+  } else {
+    readyToRequest = false;
+    LOG_PRINTF("[JOURNAL] upload... failed, error: %s\n", SPS_AsyncHTTP::errorToString(response.code));
+  }
+}
+
+// upload the oldest journal records, one batch in flight at a time
+void drainJournal() {
+  if (journal.getPending() == 0 || journalInFlight || !readyToRequest ||
+      (lastJournalUpload != 0 && millis() - lastJournalUpload < JOURNAL_RETRY_MS)) {
+    return;
+  }
+
+  SPS_Journal::Record records[JOURNAL_BATCH_RECORDS];
+  uint32_t throughSeq;
+  uint8_t count = journal.peek(records, JOURNAL_BATCH_RECORDS, throughSeq);
+  if (count == 0) {
+    // only damaged records left
+    journal.acknowledge(throughSeq);
+    return;
+  }
+
+  // {"boot":B,"uptime":U,"events":[[seq,boot,uptime,"S","n,n,.."],[seq,boot,uptime,"R",result,"0X6D-.."]]}
+  unsigned long start = micros();
+  size_t length = snprintf(requestBody, sizeof(requestBody), "{\"boot\":%u,\"uptime\":%lu,\"events\":[",
+                           journal.getBoot(), millis());
+  uint8_t included = 0;
+  for (; included < count; included++) {
+    const SPS_Journal::Record &record = records[included];
+    char value[24];
+    if (record.type == JOURNAL_STATE) {
+      value[0] = '"';
+      decodeStates(record.value, record.data, value + 1);
+      strlcat(value, "\"", sizeof(value));
     } else {
-      Serial.printf("[HTTP] GET healthcheck failed, error: %s\n", http.errorToString(httpCode).c_str());
-      failedPingCounter++;
+      int prefix = snprintf(value, sizeof(value), "%u,\"", record.value);
+      formatCardUid(record.data, value + prefix, sizeof(value) - prefix);
+      strlcat(value, "\"", sizeof(value));
     }
 
-    http.end();
+    char event[72];
+    int eventLength = snprintf(event, sizeof(event), "%s[%lu,%u,%lu,\"%c\",%s]", included > 0 ? "," : "",
+                               (unsigned long)record.seq, record.boot, (unsigned long)record.uptime, record.type,
+                               value);
+    if (included > 0 && length + eventLength + 2 > JOURNAL_BATCH_BYTES) {
+      break;
+    }
+    length += strlcpy(requestBody + length, event, sizeof(requestBody) - length);
+  }
+  strlcat(requestBody, "]}", sizeof(requestBody));
+  journalUploadSeq = included == count ? throughSeq : records[included - 1].seq;
+  jsonBuildTime = micros() - start;
+
+  bool started = false;
+  if (channel.isConnected()) {
+    LOG_PRINTF("[IO] journal:upload %u records\n", included);
+    started = channel.request("journal:upload", requestBody, 10000, onJournalUploaded, 0);
+  }
+  if (!started) {
+    LOG_PRINTF("[HTTP] POST: journalUrl %u records\n", included);
+    started = http.request("POST", journalUrl, requestBody, 10000, onJournalUploaded, 0);
+  }
+  if (started) {
+    journalInFlight = true;
+    lastJournalUpload = millis();
+  }
+}
+
+void onPingResponse(const SPS_AsyncHTTP::Response &response, int tag) {
+  pingInFlight = false;
+  printTiming(response);
+
+  if (response.code > 0) {
+    LOG_PRINTF("[HTTP] GET: healthcheck code: %d\n", response.code);
+    markServerReady();
+
+    if (response.code == HTTP_CODE_OK || response.code == HTTP_CODE_MOVED_PERMANENTLY) {
+      LOG_PRINTLN(response.body);
+    }
   } else {
-    Serial.println("[HTTP] Unable to connect");
+    LOG_PRINTF("[HTTP] GET healthcheck failed, error: %s\n", SPS_AsyncHTTP::errorToString(response.code));
     failedPingCounter++;
+    pingInterval = min(pingInterval * 2, (unsigned long)PING_MAX_INTERVAL_MS);
   }
 }
 
-void loop() {
-  if(failedPingCounter >= MAX_FAILED_PING){
-    Serial.println("Too many failed ping request, Reset WiFi...");
-    WiFi.disconnect(true);
-    delay(1000);
-    WiFiMulti.run();
-    failedPingCounter = 0;
+void pingToExpressServer () {
+  //test
+  // readyToRequest = true;
+  // return;
+
+  LOG_PRINTLN("[HTTP] GET: health check server");
+  pingInFlight = http.request("GET", healthCheckUrl, NULL, 2000, onPingResponse, 0);
+}
+
+#ifdef HTTP_BENCHMARK
+void onBenchmarkResponse(const SPS_AsyncHTTP::Response &response, int tag) {
+  benchmarkSequentialTime += (response.connectTime + response.sendTime + response.waitTime) / 1000;
+  if (--benchmarkPending > 0) {
+    return;
   }
 
-  if ((WiFiMulti.run() != WL_CONNECTED)) { // wifi not is ready
-    Serial.println("WiFi is not ready...");
-    delay(500);
+  LOG_PRINTF("[BENCH] %d card checks: concurrent %lu ms, sequential %lu ms\n",
+                SPS_AsyncHTTP::POOL_SIZE, millis() - benchmarkStartTime, benchmarkSequentialTime);
+}
+
+void runHttpBenchmark() {
+  if (!readyToRequest || http.getInFlight() > 0 || millis() - benchmarkStartTime < HTTP_BENCHMARK_INTERVAL_MS) {
     return;
   }
 
-  if(!readyToRequest){ // express server is ready
-    pingToExpressServer();
-    delay(1000);
+  benchmarkStartTime = millis();
+  benchmarkSequentialTime = 0;
+  benchmarkPending = 0;
+  for (uint8_t i = 0; i < SPS_AsyncHTTP::POOL_SIZE; i++) {
+    snprintf(requestPath, sizeof(requestPath), "%s?card_id=BENCHMARK&gate_pos=%c", carEnteringUrl,
+             i % 2 == 0 ? 'R' : 'L');
+    if (http.request("GET", requestPath, NULL, 10000, onBenchmarkResponse, i)) {
+      benchmarkPending++;
+    }
   }
+}
+#endif
 
-  if((Serial.available() <= 0)) return;
+// collect one line from the Mega without blocking, true once it is complete
+bool readSerialLine() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\n') {
+      serialLine[serialLineLength] = '\0';
+      serialLineLength = 0;
+      return true;
+    }
+    if (serialLineLength < SERIAL_LINE_LENGTH - 1) {
+      serialLine[serialLineLength++] = c;
+    }
+  }
+  return false;
+}
 
-  String input = Serial.readStringUntil('\n');
-  int separatorIndex = input.indexOf(':');
+// copy value up to its end or a CR/LF without the surrounding spaces
+void copyTrimmed(char *dest, size_t size, const char *value) {
+  while (isspace((unsigned char)*value)) {
+    value++;
+  }
+  size_t length = strlcpy(dest, value, size);
+  if (length >= size) {
+    length = size - 1;
+  }
+  while (length > 0 && isspace((unsigned char)dest[length - 1])) {
+    dest[--length] = '\0';
+  }
+}
+
+void handleMegaLine(const char *input) {
+  const char *separator = strchr(input, ':');
+
+  if (separator != NULL) {
+    size_t labelLength = separator - input;
+    const char *value = separator + 1;
+
+    if (labelLength == 4 && strncmp(input, "CARD", 4) == 0) {
+      // "R:0X6D-0XE2-0XD7-0X21"
+      const char *idSeparator = strchr(value, ':');
+      char cardId[CARD_ID_SIZE];
+      copyTrimmed(cardId, sizeof(cardId), idSeparator != NULL ? idSeparator + 1 : value);
 
-  if (separatorIndex != -1) {
-    String label = input.substring(0, separatorIndex);
-    String value = input.substring(separatorIndex + 1);
+      cardLines++;
+      requestToCheckCard(cardId, value[0]);
+    } else if (labelLength == 5 && strncmp(input, "STATE", 5) == 0) {
+      char states[STATE_SIZE];
+      copyTrimmed(states, sizeof(states), value);
+      requestToUpdateParkingState(states);
+    }
+  }
+}
+
+#ifdef CARD_BURST_BENCHMARK
+void runCardBurst() {
+  if (!readyToRequest || burstPending > 0 || millis() - burstStartTime < CARD_BURST_INTERVAL_MS) {
+    return;
+  }
+
+  burstStartTime = millis();
+  burstPending = CARD_BURST_SIZE;
+  burstNumber++;
+  for (uint8_t i = 0; i < CARD_BURST_SIZE; i++) {
+    char line[SERIAL_LINE_LENGTH];
+    snprintf(line, sizeof(line), "CARD:%c:0XB0-0X%02X-0X%02X-0X%02X", i % 2 == 0 ? 'R' : 'L', burstNumber >> 8,
+             burstNumber & 0xFF, i);
+    handleMegaLine(line);
+  }
+}
+#endif
+
+// Mega lines and the card checks they start, every pass
+unsigned long serialTask() {
+  while (readSerialLine()) {
+    handleMegaLine(serialLine);
+  }
+  flushCardBatch();
+  return 0;
+}
+
+// deliver answers and pushes, every pass
+unsigned long networkTask() {
+  http.update();
+  // the channel only reconnects once a health check got through, its connect blocks
+  channel.update(readyToRequest);
+#ifdef JSON_BENCHMARK
+  if (ESP.getFreeHeap() < minFreeHeap) {
+    minFreeHeap = ESP.getFreeHeap();
+  }
+#endif
+
+  if (channel.isConnected() != channelWasConnected) {
+    channelWasConnected = channel.isConnected();
+    if (!channelWasConnected) {
+      // the server may be gone, ping it before the channel tries again
+      readyToRequest = false;
+    }
+  }
+  if (channel.isRejected() != channelWasRejected) {
+    channelWasRejected = channel.isRejected();
+    if (channelWasRejected) {
+      LOG_PRINTF("[IO] bridge token refused, next try in %d s, HTTP meanwhile\n",
+                 SPS_BridgeChannel::REJECTED_BACKOFF_MS / 1000);
+    }
+  }
+  return 0;
+}
 
-    if(label == "CARD"){
-      separatorIndex = value.indexOf(':');
-      String gatePos = value.substring(0, separatorIndex);
-      String cardId = value.substring(separatorIndex + 1);
+// keep the station connected without waiting for it, the SDK connects in the background
+unsigned long wifiTask() {
+  if (failedPingCounter >= MAX_FAILED_PING) {
+    LOG_PRINTLN("Too many failed ping request, Reset WiFi...");
+    http.stop();
+    channel.stop();
+    // the radio stays on and the same access point is joined again, only the address is asked for anew
+    wifi.reconnect();
+    wifiReady = false;
+    readyToRequest = false;
+    failedPingCounter = 0;
+    return WIFI_CHECK_MS;
+  }
 
-      requestToCheckCard(cardId, gatePos);
-    } else if(label == "STATE") {
-      value.trim();
-      requestToUpdateParkingState(value);
+  if (wifi.update()) {
+    if (!wifiReady) {
+      LOG_PRINTF("[WIFI] connected in %lu ms (%s)\n", wifi.getConnectTime(), wifi.isFastConnect() ? "cached" : "scan");
+      if (wifiReadyAt == 0) {
+        wifiReadyAt = millis();
+      }
     }
-  }  
-}
\ No newline at end of file
+    wifiReady = true;
+    return WIFI_CHECK_MS;
+  }
+
+  LOG_PRINTLN("WiFi is not ready...");
+  wifiReady = false;
+  readyToRequest = false;
+  return WIFI_CHECK_MS;
+}
+
+// find out whether the server is up, failed pings back off exponentially
+unsigned long healthTask() {
+  if (!wifiReady) {
+    return PING_INTERVAL_MS;
+  }
+
+  // a connected channel already proves the server is up, polling is only needed without it
+  if (!readyToRequest && channel.isConnected()) {
+    markServerReady();
+  }
+  if (!readyToRequest && !pingInFlight) { // express server is ready
+    pingToExpressServer();
+  }
+  return pingInterval;
+}
+
+// start the requests that wait for their time
+unsigned long dispatchTask() {
+#ifdef HTTP_BENCHMARK
+  runHttpBenchmark();
+#endif
+#ifdef CARD_BURST_BENCHMARK
+  runCardBurst();
+#endif
+
+  drainJournal();
+  flushParkingState();
+  return DISPATCH_INTERVAL_MS;
+}
+
+#if LOG_OUTPUT != LOG_NONE
+// bytes per CARD line: the protocol's share of the Mega link and the diagnostics kept off it
+void printLinkCounters() {
+  unsigned long cards = cardLines > 0 ? cardLines : 1;
+  LOG_PRINTF("[LINK] cards: %lu mega: %lu B (%lu B/card) log: %lu B (%lu B/card) on %s\n", cardLines,
+             megaLink.getBytes(), megaLink.getBytes() / cards, logOutput.getBytes(), logOutput.getBytes() / cards,
+             LOG_OUTPUT == LOG_UART0 ? "UART0" : "UART1");
+}
+
+unsigned long logTask() {
+  scheduler.printStats(logOutput);
+  printLinkCounters();
+  return LOG_INTERVAL_MS;
+}
+#endif
+
+void loop() {
+  scheduler.run();
+}
@@ -0,0 +1,151 @@
+"""
+Stand-in for the express server, answers the ESP bridge's HTTP requests
+without a database or camera so card check throughput can be measured.
+
+Every card is accepted unless given with --reject. --delay holds every
+answer back like the plate check of the real server does, the cards of
+one batch are checked together so a batch costs one delay.
+
+    python3 tools/stand_in_server.py --port 4000 --delay 300
+
+Prints requests, card checks and cards per request every --report seconds.
+"""
+
+import argparse
+import json
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+CARD_URL = "/api/v1/cards/linked-vehicle"
+CARD_BATCH_URL = "/api/v1/cards/linked-vehicle/batch"
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.requests = 0
+        self.cards = 0
+
+    def add(self, cards):
+        with self.lock:
+            self.requests += 1
+            self.cards += cards
+
+    def take(self):
+        with self.lock:
+            requests, cards = self.requests, self.cards
+            self.requests, self.cards = 0, 0
+        return requests, cards
+
+
+class Handler(BaseHTTPRequestHandler):
+    # keep-alive, like the express server
+    protocol_version = "HTTP/1.1"
+
+    def check(self, card_id):
+        if card_id in self.server.rejected:
+            return {"status": 404}
+        return {"status": 200, "info": self.server.username}
+
+    def answer(self, status, payload):
+        body = json.dumps(payload, separators=(",", ":")).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        if length == 0:
+            return {}
+        return json.loads(self.rfile.read(length))
+
+    def do_GET(self):
+        if self.path == "/healthcheck":
+            self.answer(200, {"message": "OK"})
+            return
+
+        if self.path.startswith(CARD_URL + "?"):
+            query = dict(
+                part.split("=", 1)
+                for part in self.path.split("?", 1)[1].split("&")
+                if "=" in part
+            )
+            card_id = query.get("card_id", "").replace("%2D", "-")
+            time.sleep(self.server.delay)
+            self.server.stats.add(1)
+            result = self.check(card_id)
+            self.answer(result["status"], {"info": result.get("info")})
+            return
+
+        self.answer(404, {"message": "Not found"})
+
+    def do_POST(self):
+        body = self.read_body()
+
+        if self.path == CARD_BATCH_URL:
+            checks = body.get("checks", [])
+            time.sleep(self.server.delay)
+            self.server.stats.add(len(checks))
+            self.answer(
+                200,
+                {
+                    "message": "Successfull",
+                    "info": [self.check(c.get("cardId")) for c in checks],
+                },
+            )
+            return
+
+        # journal uploads and anything else the bridge sends
+        self.answer(200, {"message": "Successfull"})
+
+    def do_PUT(self):
+        self.read_body()
+        self.answer(200, {"message": "Successfull"})
+
+    do_PATCH = do_PUT
+
+    def log_message(self, format, *args):
+        if self.server.verbose:
+            super().log_message(format, *args)
+
+
+def report(server, interval):
+    while True:
+        time.sleep(interval)
+        requests, cards = server.stats.take()
+        print(
+            f"[stand-in] {requests / interval:.1f} requests/s "
+            f"{cards / interval:.1f} cards/s "
+            f"{cards / requests if requests else 0:.2f} cards/request",
+            flush=True,
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=4000)
+    parser.add_argument("--delay", type=int, default=0, help="ms per request")
+    parser.add_argument("--reject", nargs="*", default=[], help="card ids")
+    parser.add_argument("--username", default="Stand-in")
+    parser.add_argument("--report", type=int, default=10, help="seconds")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.delay = args.delay / 1000
+    server.rejected = set(args.reject)
+    server.username = args.username
+    server.verbose = args.verbose
+    server.stats = Stats()
+
+    threading.Thread(target=report, args=(server, args.report), daemon=True).start()
+    print(f"[stand-in] listening on {args.host}:{args.port}", flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()